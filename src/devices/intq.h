@@ -17,8 +17,9 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+/* Queue buffer size, in bytes.  Large enough to keep the serial
+   transmit FIFO refilled across many interrupts. */
+#define INTQ_BUFSIZE 1024
 
 /* A circular queue of bytes. */
 struct intq
@@ -37,6 +37,15 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+#define FCR_TRIGGER_1 0x00      /* Receive interrupt after 1 byte. */
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* FIFOs enabled (16550A and later). */
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -46,7 +55,11 @@
 
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
-#define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_THRE 0x20           /* THR Empty (transmit FIFO empty). */
+#define LSR_TEMT 0x40           /* Transmitter completely idle. */
+
+/* Size of the 16550A transmit FIFO, in bytes. */
+#define TX_FIFO_SIZE 16
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
@@ -54,8 +67,17 @@ static enum { UNINIT, POLL, QUEUE } mode;
 /* Data to be transmitted. */
 static struct intq txq;
 
+/* Line speed, in bits per second. */
+static int serial_bps = 115200;
+
+/* Number of bytes that may be written to THR each time it
+   reports empty: TX_FIFO_SIZE if the UART has working FIFOs, 1
+   otherwise. */
+static int tx_burst;
+
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void transmit_burst (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,8 +90,9 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
-  set_serial (9600);                    /* 9.6 kbps, N-8-1. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX | FCR_TRIGGER_1);
+  tx_burst = (inb (IIR_REG) & IIR_FIFO) == IIR_FIFO ? TX_FIFO_SIZE : 1;
+  set_serial (serial_bps);              /* N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
   intq_init (&txq);
   mode = POLL;
@@ -136,7 +159,32 @@ serial_flush (void)
 {
   enum intr_level old_level = intr_disable ();
   while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+    {
+      while ((inb (LSR_REG) & LSR_THRE) == 0)
+        continue;
+      transmit_burst ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Sets the line speed to BPS bits per second, which must be
+   between 300 and 115,200.  Output already queued is sent at
+   the old speed first. */
+void
+serial_set_bps (int bps) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  serial_bps = bps;
+  if (mode == UNINIT)
+    init_poll ();
+  else
+    {
+      serial_flush ();
+      while ((inb (LSR_REG) & LSR_TEMT) == 0)
+        continue;
+      set_serial (bps);
+    }
   intr_set_level (old_level);
 }
 
@@ -193,6 +241,19 @@ write_ier (void)
   outb (IER_REG, ier);
 }
 
+/* Writes as many queued bytes to THR as the transmit FIFO can
+   hold.  THR must be empty. */
+static void
+transmit_burst (void) 
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < tx_burst && !intq_empty (&txq); i++)
+    outb (THR_REG, intq_getc (&txq));
+}
+
 /* Polls the serial port until it's ready,
    and then transmits BYTE. */
 static void
@@ -218,10 +279,10 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmit FIFO has drained, refill it from the
+     queue. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    transmit_burst ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -6,6 +6,7 @@
 void serial_init_queue (void);
 void serial_putc (uint8_t);
 void serial_flush (void);
+void serial_set_bps (int bps);
 void serial_notify (void);
 
 #endif /* devices/serial.h */
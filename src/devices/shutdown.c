@@ -13,6 +13,9 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -57,6 +60,7 @@ void
 shutdown_reboot (void)
 {
   printf ("Rebooting...\n");
+  console_flush ();
 
     /* See [kbd] for details on how to program the keyboard
      * controller. */
@@ -97,6 +101,7 @@ shutdown_power_off (void)
   print_stats ();
 
   printf ("Powering off...\n");
+  console_flush ();
   serial_flush ();
 
   /* ACPI power-off */
@@ -138,4 +143,7 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  frame_print_stats ();
+#endif
 }
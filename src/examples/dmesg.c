@@ -0,0 +1,22 @@
+/* dmesg.c
+
+   Prints the most recent kernel output. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+static char buf[16384];
+
+int
+main (void)
+{
+  int bytes = dmesg (buf, sizeof buf);
+
+  if (bytes < 0)
+    {
+      printf ("dmesg: failed\n");
+      return EXIT_FAILURE;
+    }
+  write (STDOUT_FILENO, buf, bytes);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/* sysbench.c
+
+   Measures system call latency in CPU cycles.  Run it on the
+   kernels before and after a change to the system call path.
+
+   "null" traps with a number the kernel does not implement, so
+   it measures entry, dispatch and return only, through both
+   "int $0x30" and, if the CPU has it, sysenter.  "seek" adds two
+   argument words, and "write" adds a buffer pointer check; both
+   use whichever entry the C library picked. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+#define ITERATIONS 10000
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* A system call number the kernel does not implement. */
+#define NULL_SYSCALL (SYS_AIO_ENTER + 1000)
+
+static void
+null_int (void)
+{
+  asm volatile ("pushl %0; int $0x30; addl $4, %%esp"
+                : : "i" (NULL_SYSCALL) : "memory", "eax");
+}
+
+static void
+null_sysenter (void)
+{
+  asm volatile ("pushl %0; movl %%esp, %%ecx; movl $1f, %%edx; "
+                "sysenter; 1: addl $4, %%esp"
+                : : "i" (NULL_SYSCALL) : "memory", "eax", "ecx", "edx");
+}
+
+/* Returns true if the CPU supports sysenter. */
+static bool
+has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & (1u << 11)) != 0;
+}
+
+/* Runs CALL ITERATIONS times and prints its mean cost. */
+static void
+measure (const char *name, void (*call) (void))
+{
+  uint64_t start, end;
+  int i;
+
+  call ();
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++)
+    call ();
+  end = rdtsc ();
+  printf ("%-14s %8llu cycles/call\n", name,
+          (unsigned long long) ((end - start) / ITERATIONS));
+}
+
+static void
+seek_call (void)
+{
+  seek (-1, 0);
+}
+
+static void
+write_call (void)
+{
+  static char buf[1];
+  write (STDOUT_FILENO, buf, 0);
+}
+
+int
+main (void)
+{
+  measure ("null/int", null_int);
+  if (has_sysenter ())
+    measure ("null/sysenter", null_sysenter);
+  measure ("seek", seek_call);
+  measure ("write", write_call);
+  return EXIT_SUCCESS;
+}
@@ -2,9 +2,12 @@
 
 #include "lib/debug.h"
 #include "lib/string.h"
+#include "lib/stdlib.h"
+#include "lib/kernel/list.h"
 #include "devices/block.h"
 #include "threads/synch.h"
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
 
 #define CACHE_CNT 64
 
@@ -12,9 +15,26 @@ static struct cache_entry cache_array[CACHE_CNT];
 static int second_chance_idx;
 static struct lock cache_lock;
 
+/* A buffer_cache_sync() caller waiting for its sectors to reach
+   disk. */
+struct sync_request{
+    const block_sector_t *sectors; /* Sorted, or NULL for every sector. */
+    size_t cnt;
+    bool done;
+    struct list_elem elem;
+};
+
+static struct lock sync_lock;     /* Protects the fields below. */
+static struct condition sync_cond;/* Signaled when a flush finishes. */
+static struct list sync_queue;    /* Requests not yet picked up. */
+static bool sync_running;         /* True while a flush is in progress. */
+
 struct cache_entry * buffer_cache_lookup(block_sector_t sector);
 struct cache_entry * find_entry_to_store(void);
 int get_idx(void);
+static void cache_fill(struct cache_entry *entry, block_sector_t sector);
+static void cache_write_back(struct cache_entry *entry);
+static bool sync_wanted(struct list *batch, block_sector_t sector);
 
 void buffer_cache_init(void){
     for(int i=0; i<CACHE_CNT; i++){
@@ -23,21 +43,77 @@ void buffer_cache_init(void){
     }
     lock_init(&cache_lock);
     second_chance_idx = 0;
+    lock_init(&sync_lock);
+    cond_init(&sync_cond);
+    list_init(&sync_queue);
+    sync_running = false;
 }
 
 //Prepare for filesys_done, do flush
 void buffer_cache_close(void){
     // lock_acquire(&cache_lock);
     for(int i=0; i<CACHE_CNT; i++){
-        if(cache_array[i].is_use && cache_array[i].is_dirty){
-            block_write(fs_device, cache_array[i].sector, cache_array[i].data);
-            cache_array[i].is_dirty = false;
-        }
+        if(cache_array[i].is_use)
+            cache_write_back(&cache_array[i]);
     }
     // lock_release(&cache_lock);
     return;
 }
 
+/* Orders block sector numbers for qsort() and bsearch().
+*/
+static int compare_sectors(const void *a_, const void *b_){
+    const block_sector_t *a = a_, *b = b_;
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Writes the dirty cached copies of the CNT SECTORS to disk and
+   commits the journal, or does so for every sector if SECTORS
+   is NULL.  SECTORS is sorted in place.
+   Callers that arrive while a flush is running queue up; the
+   next flush then serves all of them in a single pass over the
+   cache and a single journal commit.
+*/
+void buffer_cache_sync(block_sector_t *sectors, size_t cnt){
+    struct sync_request req;
+    struct list batch;
+    struct list_elem *e;
+
+    if(sectors != NULL)
+        qsort(sectors, cnt, sizeof *sectors, compare_sectors);
+    req.sectors = sectors;
+    req.cnt = cnt;
+    req.done = false;
+
+    lock_acquire(&sync_lock);
+    list_push_back(&sync_queue, &req.elem);
+    while(sync_running && !req.done)
+        cond_wait(&sync_cond, &sync_lock);
+    if(!req.done){
+        /* Lead a flush on behalf of everyone queued so far. */
+        sync_running = true;
+        list_init(&batch);
+        list_splice(list_end(&batch), list_begin(&sync_queue), list_end(&sync_queue));
+        lock_release(&sync_lock);
+
+        lock_acquire(&cache_lock);
+        for(int i=0; i<CACHE_CNT; i++){
+            if(cache_array[i].is_use && cache_array[i].is_dirty
+               && sync_wanted(&batch, cache_array[i].sector))
+                cache_write_back(&cache_array[i]);
+        }
+        lock_release(&cache_lock);
+        journal_commit();
+
+        lock_acquire(&sync_lock);
+        for(e = list_begin(&batch); e != list_end(&batch); e = list_next(e))
+            list_entry(e, struct sync_request, elem)->done = true;
+        sync_running = false;
+        cond_broadcast(&sync_cond, &sync_lock);
+    }
+    lock_release(&sync_lock);
+}
+
 //Substitute of block_write
 //default option: sector_ofs = 0, chunk_size = BLOCK_SECTOR_SIZE
 void buffer_cache_write(block_sector_t sector, const void *buffer, int sector_ofs, int chunk_size){
@@ -50,10 +126,8 @@ void buffer_cache_write(block_sector_t sector, const void *buffer, int sector_of
         entry = find_entry_to_store();
         entry->is_use = true;
         entry->sector = sector;
-        if (sector_ofs > 0) 
-            block_read(fs_device, sector, entry->data);
-        else
-            memset (entry->data, 0, BLOCK_SECTOR_SIZE);
+        if (chunk_size < BLOCK_SECTOR_SIZE)
+            cache_fill(entry, sector);
     }
     memcpy(entry->data + sector_ofs, buffer, chunk_size);
     entry->is_accessed = true;
@@ -73,13 +147,32 @@ void buffer_cache_read(block_sector_t sector, void * buffer, int sector_ofs, int
         entry->is_use = true;
         entry->sector = sector;
         entry->is_dirty = false;
-        block_read(fs_device, sector, entry->data);
+        cache_fill(entry, sector);
     }
     memcpy(buffer, entry->data + sector_ofs, chunk_size);
     entry->is_accessed = true;
     lock_release(&cache_lock);   
 };
 
+/* Reads SECTOR into BUFFER, from the cache if it holds the
+   sector, but without caching it otherwise.  For data that is
+   cached elsewhere, such as file pages mapped into user
+   processes, so that it is in memory only once.
+*/
+void buffer_cache_read_direct(block_sector_t sector, void *buffer){
+    struct cache_entry * entry;
+
+    lock_acquire(&cache_lock);
+    entry = buffer_cache_lookup(sector);
+    if (entry != NULL){
+        memcpy(buffer, entry->data, BLOCK_SECTOR_SIZE);
+        entry->is_accessed = true;
+    }else if(!journal_read(sector, buffer)){
+        block_read(fs_device, sector, buffer);
+    }
+    lock_release(&cache_lock);
+}
+
 /* Find cache array element
 */
 struct cache_entry * buffer_cache_lookup(block_sector_t sector){
@@ -108,10 +201,7 @@ struct cache_entry * find_entry_to_store(void){
         if(cache_array[current_idx].is_accessed){
             cache_array[current_idx].is_accessed = false;
         }else{
-            /*Todo Dirty bit check*/
-            if(cache_array[current_idx].is_dirty){
-                block_write(fs_device, cache_array[current_idx].sector, cache_array[current_idx].data);
-            }
+            cache_write_back(&cache_array[current_idx]);
             return &cache_array[current_idx];
         }
     }
@@ -123,4 +213,36 @@ int get_idx(void){
     int ret = second_chance_idx;
     second_chance_idx = (second_chance_idx+1)%CACHE_CNT;
     return ret;
-}
\ No newline at end of file
+}
+
+/* Loads SECTOR into ENTRY, preferring a newer copy held by the
+   journal over the one on disk.
+*/
+static void cache_fill(struct cache_entry *entry, block_sector_t sector){
+    if(!journal_read(sector, entry->data))
+        block_read(fs_device, sector, entry->data);
+}
+
+/* Writes ENTRY back to disk if it is dirty.  Sectors the journal
+   has not checkpointed yet are left for the journal to write.
+*/
+static void cache_write_back(struct cache_entry *entry){
+    if(entry->is_dirty){
+        if(!journal_owns(entry->sector))
+            block_write(fs_device, entry->sector, entry->data);
+        entry->is_dirty = false;
+    }
+}
+
+/* Returns true if some request in BATCH asks for SECTOR.
+*/
+static bool sync_wanted(struct list *batch, block_sector_t sector){
+    struct list_elem *e;
+    for(e = list_begin(batch); e != list_end(batch); e = list_next(e)){
+        struct sync_request *req = list_entry(e, struct sync_request, elem);
+        if(req->sectors == NULL
+           || bsearch(&sector, req->sectors, req->cnt, sizeof sector, compare_sectors) != NULL)
+            return true;
+    }
+    return false;
+}
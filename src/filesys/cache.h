@@ -19,3 +19,5 @@ void buffer_cache_init(void);
 void buffer_cache_close(void);
 void buffer_cache_write(block_sector_t sector, const void *buffer, int sector_ofs, int chunk_size);
 void buffer_cache_read(block_sector_t sector, void * buffer, int sector_ofs, int chunk_size);
+void buffer_cache_read_direct(block_sector_t sector, void *buffer);
+void buffer_cache_sync(block_sector_t *sectors, size_t cnt);
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 
 /* An open file. */
 struct file 
@@ -113,6 +114,48 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from IN, starting at IN's current
+   position, to OUT, starting at OUT's current position, without
+   the data ever leaving the kernel.  Data moves through the
+   buffer cache a page at a time.
+   Returns the number of bytes actually copied, which may be
+   less than SIZE if end of IN is reached or OUT cannot grow.
+   Advances both positions by the number of bytes copied.  IN
+   and OUT must not be the same file. */
+off_t
+file_copy (struct file *out, struct file *in, off_t size)
+{
+  off_t bytes_copied = 0;
+  void *buffer;
+
+  ASSERT (in != out);
+
+  buffer = malloc (PGSIZE);
+  if (buffer == NULL)
+    return 0;
+
+  while (size > 0)
+    {
+      off_t chunk_size = size < PGSIZE ? size : PGSIZE;
+      off_t bytes_read, bytes_written;
+
+      bytes_read = inode_read_at (in->inode, buffer, chunk_size, in->pos);
+      if (bytes_read == 0)
+        break;
+      bytes_written = inode_write_at (out->inode, buffer, bytes_read,
+                                      out->pos);
+      in->pos += bytes_written;
+      out->pos += bytes_written;
+      bytes_copied += bytes_written;
+      if (bytes_written != bytes_read)
+        break;
+      size -= bytes_written;
+    }
+
+  free (buffer);
+  return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -7,6 +7,7 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
@@ -23,6 +24,7 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
   
   buffer_cache_init();
+  journal_init (format);
   inode_init ();
   free_map_init ();
   if (format) 
@@ -37,6 +39,7 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_done ();
   buffer_cache_close();
 }
 
@@ -56,12 +59,14 @@ filesys_create (const char *name, off_t initial_size, bool is_dir)
 //  printf ("dir_path : %s, file_name : %s\n", dir_path, file_name);
   struct dir *dir = dir_open_path(dir_path);
 
+  journal_begin ();
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector)
                   && inode_create (inode_sector, initial_size, is_dir)
                   && dir_add (dir, file_name, inode_sector, is_dir));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
+  journal_end ();
   dir_close (dir);
 
   return success;
@@ -107,7 +112,9 @@ filesys_remove (const char *name)
   split_path(name, dir_path, file_name);
   struct dir *dir = dir_open_path(dir_path);
 
+  journal_begin ();
   bool success = dir != NULL && dir_remove (dir, file_name);
+  journal_end ();
   dir_close (dir); 
 
   return success;
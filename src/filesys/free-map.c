@@ -5,6 +5,7 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
@@ -18,6 +19,8 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, journal_first_sector (), JOURNAL_SECTORS,
+                       true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -51,6 +54,8 @@ free_map_release (block_sector_t sector, size_t cnt)
 {
   if (sector == (block_sector_t) -2) return;
   ASSERT (bitmap_all (free_map, sector, cnt));
+  for (size_t i = 0; i < cnt; i++)
+    journal_revoke (sector + i);
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
 }
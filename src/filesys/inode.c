@@ -7,6 +7,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 
 /* Identifies an inode. */
@@ -65,6 +66,14 @@ inode_is_dir (struct inode *inode)
   return inode->data.is_dir;
 }
 
+/* Returns true if INODE's contents are file system metadata
+   (a directory or the free map), whose writes are journaled. */
+static bool
+inode_is_metadata (struct inode *inode)
+{
+  return inode->data.is_dir || inode->sector == FREE_MAP_SECTOR;
+}
+
 int
 inode_get_open_cnt (struct inode *inode)
 {
@@ -124,6 +133,9 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return -1;
 }
 
+static off_t read_at (struct inode *, void *, off_t size, off_t offset,
+                     bool cache);
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
@@ -154,6 +166,7 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
+      journal_begin ();
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
@@ -218,22 +231,22 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
 
         switch (status) {
           case DIRECT:
-            buffer_cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+            journal_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
             break;
           case INDIRECT:
             if (!idx_in_indirect) {
-              buffer_cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+              journal_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
             }
-            buffer_cache_write(disk_inode->indirect, indirect_inode, 0, BLOCK_SECTOR_SIZE);
+            journal_write(disk_inode->indirect, indirect_inode, 0, BLOCK_SECTOR_SIZE);
             break;
           case DOUBLEY_INDIRECT:
             if (!idx_in_doubly) {
-              buffer_cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+              journal_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
             }
             if (!idx_in_indirect_for_doubly) {
-              buffer_cache_write(disk_inode->doubley_indirect, doubly_indirect_inode, 0, BLOCK_SECTOR_SIZE);
+              journal_write(disk_inode->doubley_indirect, doubly_indirect_inode, 0, BLOCK_SECTOR_SIZE);
             }
-            buffer_cache_write (doubly_indirect_inode->indirect[idx_in_doubly], indirect_for_doubly[idx_in_doubly], 0, BLOCK_SECTOR_SIZE);
+            journal_write (doubly_indirect_inode->indirect[idx_in_doubly], indirect_for_doubly[idx_in_doubly], 0, BLOCK_SECTOR_SIZE);
             break;
           default:
             PANIC("Cannot reach here!");
@@ -263,7 +276,7 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
       }
       
       success = true;
-      buffer_cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      journal_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
 
       free (disk_inode);
       free (indirect_inode);
@@ -271,6 +284,7 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
       for(int i=0; i<INDIRECT_BLOCK_CNT; i++){
         free (indirect_for_doubly[i]);
       }
+      journal_end ();
     }
   return success;
 }
@@ -347,6 +361,7 @@ inode_close (struct inode *inode)
       //TODO. dir case. Delete after check dir is empty 
       if (inode->removed) 
         {
+          journal_begin ();
           enum sector_status status = DIRECT;
           struct inode_disk * in_disk = &inode->data;
           size_t sector_cnt = in_disk->length / BLOCK_SECTOR_SIZE;
@@ -424,6 +439,7 @@ inode_close (struct inode *inode)
             free (indirect_for_doubly[i]);
           }
           free_map_release(inode->sector, 1);
+          journal_end ();
         }
       free (inode); 
     }
@@ -442,7 +458,27 @@ inode_remove (struct inode *inode)
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  return read_at (inode, buffer, size, offset, true);
+}
+
+/* Reads like inode_read_at(), but whole sectors that the buffer
+   cache does not hold go straight into BUFFER without being
+   cached.  For file pages mapped into user processes, which the
+   VM page cache keeps, so that their data is in memory once. */
+off_t
+inode_read_direct (struct inode *inode, void *buffer, off_t size,
+                   off_t offset) 
+{
+  return read_at (inode, buffer, size, offset, false);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, through the buffer cache if CACHE is true. */
+static off_t
+read_at (struct inode *inode, void *buffer_, off_t size, off_t offset,
+         bool cache) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
@@ -465,6 +501,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       if (sector_idx == (block_sector_t) -2) {
         memset (buffer+bytes_read, 0, chunk_size);
+      } else if (!cache && chunk_size == BLOCK_SECTOR_SIZE) {
+        buffer_cache_read_direct (sector_idx, buffer + bytes_read);
       } else {
         buffer_cache_read(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       }
@@ -496,12 +534,12 @@ inode_append_sector (struct inode *inode, block_sector_t sector_idx, off_t size)
       block_sector_t indirect_idx;
       free_map_allocate(1, &indirect_idx);
       disk_inode->indirect=indirect_idx;
-      buffer_cache_write(inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      journal_write(inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
     }
     indirect_inode = (struct inode_for_indirect *)calloc(1, sizeof(struct inode_for_indirect));
     buffer_cache_read (disk_inode->indirect, indirect_inode, 0, BLOCK_SECTOR_SIZE);
     indirect_inode->indirect[sector_cnt - DIRECT_BLOCK_CNT] = sector_idx;
-    buffer_cache_write (disk_inode->indirect, indirect_inode, 0, BLOCK_SECTOR_SIZE);
+    journal_write (disk_inode->indirect, indirect_inode, 0, BLOCK_SECTOR_SIZE);
     free (indirect_inode);
   } else {
     /* Doubly Indirect */
@@ -509,7 +547,7 @@ inode_append_sector (struct inode *inode, block_sector_t sector_idx, off_t size)
       block_sector_t doubly_indirect_idx;
       free_map_allocate(1, &doubly_indirect_idx);
       disk_inode->doubley_indirect=doubly_indirect_idx;
-      buffer_cache_write(inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      journal_write(inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
     }
 
     doubly_indirect_inode = (struct inode_for_indirect *)calloc(1, sizeof(struct inode_for_indirect));
@@ -521,18 +559,18 @@ inode_append_sector (struct inode *inode, block_sector_t sector_idx, off_t size)
       block_sector_t indirect_for_doubly_idx;
       free_map_allocate (1, &indirect_for_doubly_idx);
       doubly_indirect_inode->indirect[idx_in_doubly] = indirect_for_doubly_idx;
-      buffer_cache_write (disk_inode->doubley_indirect, doubly_indirect_inode, 0, BLOCK_SECTOR_SIZE);
+      journal_write (disk_inode->doubley_indirect, doubly_indirect_inode, 0, BLOCK_SECTOR_SIZE);
     }
 
     indirect_for_doubly[idx_in_doubly] = (struct inode_for_indirect *)calloc(1, sizeof(struct inode_for_indirect));
     buffer_cache_read (doubly_indirect_inode->indirect[idx_in_doubly], indirect_for_doubly[idx_in_doubly], 0, BLOCK_SECTOR_SIZE);
     indirect_for_doubly[idx_in_doubly]->indirect[idx_in_indirect_for_doubly] = sector_idx;
-    buffer_cache_write (doubly_indirect_inode->indirect[idx_in_doubly], indirect_for_doubly[idx_in_doubly], 0, BLOCK_SECTOR_SIZE);
+    journal_write (doubly_indirect_inode->indirect[idx_in_doubly], indirect_for_doubly[idx_in_doubly], 0, BLOCK_SECTOR_SIZE);
 
     free (doubly_indirect_inode);
     free (indirect_for_doubly[idx_in_doubly]);
   }
-  buffer_cache_write (inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+  journal_write (inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
@@ -550,6 +588,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
+  journal_begin ();
+
   block_sector_t sector_idx = byte_to_sector (inode, offset);
   if (sector_idx == (block_sector_t) -1 && size>0){
     /* Offset out of inode data */
@@ -557,7 +597,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
     if (offset_from_inode_data < 0) {
       inode->data.length = offset+1;
-      buffer_cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      journal_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
     }
 
     while (offset_from_inode_data >= BLOCK_SECTOR_SIZE) {
@@ -601,16 +641,19 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
         if(size+sector_ofs > BLOCK_SECTOR_SIZE){
           inode->data.length = offset + sector_left;
           //size가 커서 sector_left == chunk_size
-          buffer_cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+          journal_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
         }else{
           /*Just Length Growth*/
           inode->data.length = offset + chunk_size;
-          buffer_cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+          journal_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
         }
       /*Not last block*/
       }
 
-      buffer_cache_write(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+      if (inode_is_metadata (inode))
+        journal_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+      else
+        buffer_cache_write(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
       if(new_idx) {
         /*append sector*/
@@ -622,6 +665,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+  journal_end ();
   return bytes_written;
 }
 
@@ -651,3 +695,65 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns a newly allocated array of every sector that belongs
+   to INODE: the inode itself, its index blocks and its data
+   sectors.  Stores the number of entries into *CNT.  The caller
+   must free the array.  Returns a null pointer if memory
+   allocation fails. */
+block_sector_t *
+inode_sectors (struct inode *inode, size_t *cnt)
+{
+  struct inode_disk *disk_inode = &inode->data;
+  struct inode_for_indirect *index, *doubly;
+  size_t data_cnt = bytes_to_sectors (disk_inode->length);
+  size_t max_cnt = 3 + data_cnt + DIV_ROUND_UP (data_cnt, INDIRECT_BLOCK_CNT);
+  block_sector_t *sectors;
+  size_t n = 0;
+  size_t i, j;
+
+  sectors = malloc (max_cnt * sizeof *sectors);
+  index = malloc (sizeof *index);
+  doubly = malloc (sizeof *doubly);
+  if (sectors == NULL || index == NULL || doubly == NULL)
+    {
+      free (sectors);
+      free (index);
+      free (doubly);
+      return NULL;
+    }
+
+  sectors[n++] = inode->sector;
+  for (i = 0; i < data_cnt && i < DIRECT_BLOCK_CNT; i++)
+    sectors[n++] = disk_inode->direct[i];
+
+  if (data_cnt > DIRECT_BLOCK_CNT)
+    {
+      sectors[n++] = disk_inode->indirect;
+      buffer_cache_read (disk_inode->indirect, index, 0, BLOCK_SECTOR_SIZE);
+      for (i = DIRECT_BLOCK_CNT;
+           i < data_cnt && i < DIRECT_BLOCK_CNT + INDIRECT_BLOCK_CNT; i++)
+        sectors[n++] = index->indirect[i - DIRECT_BLOCK_CNT];
+    }
+
+  if (data_cnt > DIRECT_BLOCK_CNT + INDIRECT_BLOCK_CNT)
+    {
+      size_t left = data_cnt - DIRECT_BLOCK_CNT - INDIRECT_BLOCK_CNT;
+
+      sectors[n++] = disk_inode->doubley_indirect;
+      buffer_cache_read (disk_inode->doubley_indirect, doubly, 0,
+                         BLOCK_SECTOR_SIZE);
+      for (i = 0; left > 0; i++)
+        {
+          sectors[n++] = doubly->indirect[i];
+          buffer_cache_read (doubly->indirect[i], index, 0, BLOCK_SECTOR_SIZE);
+          for (j = 0; j < INDIRECT_BLOCK_CNT && left > 0; j++, left--)
+            sectors[n++] = index->indirect[j];
+        }
+    }
+
+  free (index);
+  free (doubly);
+  *cnt = n;
+  return sectors;
+}
@@ -0,0 +1,528 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Metadata sectors (inodes, indirect blocks, directory and free
+   map contents) are written with journal_write() between
+   journal_begin() and journal_end().  Every sector touched while
+   at least one operation is open joins the single running
+   transaction, so many operations are committed together (group
+   commit) once the last of them finishes and either enough
+   blocks have piled up or the commit interval has passed.
+
+   A commit appends a descriptor record, a copy of each block and
+   a commit record to the log.  Committed blocks stay in memory
+   until a checkpoint writes them to their home sectors, which the
+   journal daemon does in the background once the log is half
+   full.  Until then the buffer cache must not write those
+   sectors back itself; see journal_owns().
+
+   After a crash, journal_init() replays every fully committed
+   transaction still in the log.  The log is small and is reset by
+   each checkpoint, so recovery reads at most JOURNAL_SECTORS
+   sectors. */
+
+/* Identifies a journal record. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Log sectors following the header. */
+#define JOURNAL_LOG_SECTORS (JOURNAL_SECTORS - 1)
+
+/* Maximum number of blocks in one transaction. */
+#define JOURNAL_DESC_MAX 123
+
+/* Commit as soon as this many blocks are waiting. */
+#define JOURNAL_COMMIT_BLOCKS 32
+
+/* Ticks between commits by the journal daemon. */
+#define JOURNAL_COMMIT_TICKS (5 * TIMER_FREQ)
+
+enum journal_record_type
+  {
+    JOURNAL_HEADER,             /* Start of the journal area. */
+    JOURNAL_DESCRIPTOR,         /* Lists the blocks of a transaction. */
+    JOURNAL_COMMIT              /* Marks a transaction as complete. */
+  };
+
+/* On-disk journal record.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_record
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t type;                      /* A journal_record_type. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of logged blocks. */
+    uint32_t checksum;                  /* Commit: checksum of the blocks. */
+    block_sector_t sectors[JOURNAL_DESC_MAX]; /* Descriptor: home sectors. */
+  };
+
+/* In-memory copy of a journaled metadata sector. */
+struct journal_block
+  {
+    struct hash_elem elem;              /* Element in running or checkpoint. */
+    block_sector_t sector;              /* Home sector. */
+    bool valid;                         /* False until DATA is filled in. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+static block_sector_t journal_base;     /* Header sector. */
+static struct lock journal_lock;        /* Protects everything below. */
+static struct condition journal_idle;   /* Signaled when HANDLE_CNT hits 0. */
+static int handle_cnt;                  /* Number of open operations. */
+static struct hash running;             /* Blocks of the open transaction. */
+static struct hash checkpoint;          /* Committed, not yet written home. */
+static uint32_t next_seq;               /* Sequence number of RUNNING. */
+static size_t log_head;                 /* Next free log sector. */
+
+static thread_func journal_daemon NO_RETURN;
+
+static unsigned
+block_hash_func (const struct hash_elem *elem, void *aux UNUSED)
+{
+  struct journal_block *jb = hash_entry (elem, struct journal_block, elem);
+  return hash_int (jb->sector);
+}
+
+static bool
+block_less_func (const struct hash_elem *a, const struct hash_elem *b,
+                 void *aux UNUSED)
+{
+  struct journal_block *a_jb = hash_entry (a, struct journal_block, elem);
+  struct journal_block *b_jb = hash_entry (b, struct journal_block, elem);
+  return a_jb->sector < b_jb->sector;
+}
+
+static void
+block_destroy_func (struct hash_elem *elem, void *aux UNUSED)
+{
+  free (hash_entry (elem, struct journal_block, elem));
+}
+
+/* Returns the block for SECTOR in TABLE, or a null pointer. */
+static struct journal_block *
+find_block (struct hash *table, block_sector_t sector)
+{
+  struct journal_block tmp_jb;
+  struct hash_elem *elem;
+
+  tmp_jb.sector = sector;
+  elem = hash_find (table, &tmp_jb.elem);
+  return elem != NULL ? hash_entry (elem, struct journal_block, elem) : NULL;
+}
+
+/* Returns the device sector of log position POS. */
+static block_sector_t
+log_sector (size_t pos)
+{
+  ASSERT (pos < JOURNAL_LOG_SECTORS);
+  return journal_base + 1 + pos;
+}
+
+/* Writes a header declaring the log empty, with the next
+   transaction numbered NEXT_SEQ. */
+static void
+write_header (void)
+{
+  struct journal_record *rec = calloc (1, sizeof *rec);
+  if (rec == NULL)
+    PANIC ("journal: out of memory");
+  rec->magic = JOURNAL_MAGIC;
+  rec->type = JOURNAL_HEADER;
+  rec->seq = next_seq;
+  block_write (fs_device, journal_base, rec);
+  free (rec);
+}
+
+/* Waits until no operation is open.  The journal lock must be
+   held. */
+static void
+wait_idle (void)
+{
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  while (handle_cnt > 0)
+    cond_wait (&journal_idle, &journal_lock);
+}
+
+/* Writes every committed block to its home sector and empties
+   the log.  The journal lock must be held. */
+static void
+checkpoint_locked (void)
+{
+  struct hash_iterator it;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  hash_first (&it, &checkpoint);
+  while (hash_next (&it))
+    {
+      struct journal_block *jb = hash_entry (hash_cur (&it),
+                                             struct journal_block, elem);
+      block_write (fs_device, jb->sector, jb->data);
+    }
+  hash_clear (&checkpoint, block_destroy_func);
+
+  log_head = 0;
+  write_header ();
+}
+
+/* Appends the running transaction to the log and moves its
+   blocks to the checkpoint set.  The journal lock must be held.
+   Use commit_locked() unless the transaction is full. */
+static void
+write_transaction (void)
+{
+  struct journal_record *rec;
+  struct hash_iterator it;
+  size_t cnt = hash_size (&running);
+  uint32_t checksum = 0;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  if (cnt == 0)
+    return;
+  if (log_head + cnt + 2 > JOURNAL_LOG_SECTORS)
+    checkpoint_locked ();
+
+  rec = calloc (1, sizeof *rec);
+  if (rec == NULL)
+    PANIC ("journal: out of memory");
+  rec->magic = JOURNAL_MAGIC;
+  rec->type = JOURNAL_DESCRIPTOR;
+  rec->seq = next_seq;
+  rec->cnt = cnt;
+
+  /* Log a copy of each block, then the descriptor listing where
+     they belong. */
+  i = 0;
+  hash_first (&it, &running);
+  while (hash_next (&it))
+    {
+      struct journal_block *jb = hash_entry (hash_cur (&it),
+                                             struct journal_block, elem);
+      ASSERT (jb->valid);
+      rec->sectors[i] = jb->sector;
+      block_write (fs_device, log_sector (log_head + 1 + i), jb->data);
+      checksum = checksum * 31 + hash_bytes (jb->data, BLOCK_SECTOR_SIZE);
+      i++;
+    }
+  block_write (fs_device, log_sector (log_head), rec);
+
+  /* Only the commit record makes the transaction count. */
+  memset (rec, 0, sizeof *rec);
+  rec->magic = JOURNAL_MAGIC;
+  rec->type = JOURNAL_COMMIT;
+  rec->seq = next_seq;
+  rec->cnt = cnt;
+  rec->checksum = checksum;
+  block_write (fs_device, log_sector (log_head + cnt + 1), rec);
+  free (rec);
+
+  while (!hash_empty (&running))
+    {
+      struct hash_elem *elem, *old;
+
+      hash_first (&it, &running);
+      elem = hash_next (&it);
+      hash_delete (&running, elem);
+      old = hash_replace (&checkpoint, elem);
+      if (old != NULL)
+        block_destroy_func (old, NULL);
+    }
+
+  log_head += cnt + 2;
+  next_seq++;
+}
+
+/* Commits the running transaction.  No operation may be open and
+   the journal lock must be held. */
+static void
+commit_locked (void)
+{
+  ASSERT (handle_cnt == 0);
+  write_transaction ();
+}
+
+/* Replays the transaction numbered SEQ that starts at log
+   position POS, using DESC, COMMIT and DATA as scratch space.
+   Returns the number of log sectors it occupies, or 0 if there
+   is no fully committed transaction there. */
+static size_t
+replay_transaction (size_t pos, uint32_t seq, struct journal_record *desc,
+                    struct journal_record *commit, uint8_t *data)
+{
+  uint32_t checksum = 0;
+  size_t i;
+
+  if (pos + 2 > JOURNAL_LOG_SECTORS)
+    return 0;
+  block_read (fs_device, log_sector (pos), desc);
+  if (desc->magic != JOURNAL_MAGIC || desc->type != JOURNAL_DESCRIPTOR
+      || desc->seq != seq || desc->cnt > JOURNAL_DESC_MAX
+      || pos + desc->cnt + 2 > JOURNAL_LOG_SECTORS)
+    return 0;
+
+  block_read (fs_device, log_sector (pos + desc->cnt + 1), commit);
+  if (commit->magic != JOURNAL_MAGIC || commit->type != JOURNAL_COMMIT
+      || commit->seq != seq || commit->cnt != desc->cnt)
+    return 0;
+
+  for (i = 0; i < desc->cnt; i++)
+    {
+      block_read (fs_device, log_sector (pos + 1 + i), data);
+      checksum = checksum * 31 + hash_bytes (data, BLOCK_SECTOR_SIZE);
+    }
+  if (checksum != commit->checksum)
+    return 0;
+
+  for (i = 0; i < desc->cnt; i++)
+    {
+      block_read (fs_device, log_sector (pos + 1 + i), data);
+      block_write (fs_device, desc->sectors[i], data);
+    }
+  return desc->cnt + 2;
+}
+
+/* Brings the file system up to date with every committed
+   transaction in the log, then empties the log. */
+static void
+recover (void)
+{
+  struct journal_record *desc = malloc (sizeof *desc);
+  struct journal_record *commit = malloc (sizeof *commit);
+  uint8_t *data = malloc (BLOCK_SECTOR_SIZE);
+  size_t replayed = 0;
+
+  if (desc == NULL || commit == NULL || data == NULL)
+    PANIC ("journal: out of memory");
+
+  block_read (fs_device, journal_base, desc);
+  if (desc->magic == JOURNAL_MAGIC && desc->type == JOURNAL_HEADER)
+    {
+      size_t pos = 0;
+      size_t len;
+
+      next_seq = desc->seq;
+      while ((len = replay_transaction (pos, next_seq, desc, commit, data)))
+        {
+          pos += len;
+          next_seq++;
+          replayed++;
+        }
+    }
+  else
+    next_seq = 1;
+
+  if (replayed > 0)
+    printf ("journal: replayed %zu transactions\n", replayed);
+
+  free (desc);
+  free (commit);
+  free (data);
+
+  log_head = 0;
+  write_header ();
+}
+
+/* Initializes the journal.  If FORMAT is true, starts with an
+   empty log; otherwise replays whatever the log holds. */
+void
+journal_init (bool format)
+{
+  ASSERT (sizeof (struct journal_record) == BLOCK_SECTOR_SIZE);
+  if (block_size (fs_device) < 4 * JOURNAL_SECTORS)
+    PANIC ("file system device too small for the journal");
+
+  journal_base = block_size (fs_device) - JOURNAL_SECTORS;
+  lock_init (&journal_lock);
+  cond_init (&journal_idle);
+  handle_cnt = 0;
+  hash_init (&running, block_hash_func, block_less_func, NULL);
+  hash_init (&checkpoint, block_hash_func, block_less_func, NULL);
+
+  if (format)
+    {
+      next_seq = 1;
+      log_head = 0;
+      write_header ();
+    }
+  else
+    recover ();
+
+  thread_create ("journald", PRI_DEFAULT, journal_daemon, NULL);
+}
+
+/* Commits outstanding metadata and checkpoints the whole log,
+   leaving every journaled sector in its home location. */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  wait_idle ();
+  commit_locked ();
+  checkpoint_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Returns the first sector of the journal area. */
+block_sector_t
+journal_first_sector (void)
+{
+  return journal_base;
+}
+
+/* Opens an operation.  Metadata written until the matching
+   journal_end() is committed atomically.  Calls may nest. */
+void
+journal_begin (void)
+{
+  lock_acquire (&journal_lock);
+  handle_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Closes an operation opened by journal_begin().  Commits the
+   running transaction if it is idle and large enough. */
+void
+journal_end (void)
+{
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  if (--handle_cnt == 0)
+    {
+      cond_broadcast (&journal_idle, &journal_lock);
+      if (hash_size (&running) >= JOURNAL_COMMIT_BLOCKS)
+        commit_locked ();
+    }
+  lock_release (&journal_lock);
+}
+
+/* Writes CHUNK_SIZE bytes of metadata from BUFFER into SECTOR
+   at SECTOR_OFS, through the buffer cache, and adds SECTOR to
+   the running transaction. */
+void
+journal_write (block_sector_t sector, const void *buffer, int sector_ofs,
+               int chunk_size)
+{
+  struct journal_block *jb;
+
+  lock_acquire (&journal_lock);
+  jb = find_block (&running, sector);
+  if (jb == NULL)
+    {
+      /* Creating or growing a large file can touch more blocks
+         than one transaction holds.  The full transaction is then
+         committed in the middle of the operation, which goes on
+         in a new one.  Operations run one at a time under the file
+         system lock, and growing a file allocates sectors in the
+         free map before pointing to them, so a crash between the
+         parts leaves a shorter file and leaked sectors at worst,
+         never a pointer to a free sector. */
+      if (hash_size (&running) >= JOURNAL_DESC_MAX)
+        write_transaction ();
+      jb = malloc (sizeof *jb);
+      if (jb == NULL)
+        PANIC ("journal: out of memory");
+      jb->sector = sector;
+      jb->valid = false;
+      hash_insert (&running, &jb->elem);
+    }
+  lock_release (&journal_lock);
+
+  /* The cache calls back into the journal, so the journal lock
+     must not be held here. */
+  buffer_cache_write (sector, buffer, sector_ofs, chunk_size);
+  buffer_cache_read (sector, jb->data, 0, BLOCK_SECTOR_SIZE);
+  jb->valid = true;
+}
+
+/* Tells the journal that SECTOR has been freed and may be
+   reused for file data.  Any copy of it still in the log is
+   written home and the log emptied, so that a later replay
+   cannot overwrite the new contents. */
+void
+journal_revoke (block_sector_t sector)
+{
+  struct journal_block *jb;
+
+  lock_acquire (&journal_lock);
+  jb = find_block (&running, sector);
+  if (jb != NULL)
+    {
+      hash_delete (&running, &jb->elem);
+      free (jb);
+    }
+  if (find_block (&checkpoint, sector) != NULL)
+    checkpoint_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction now.  Must not be called
+   between journal_begin() and journal_end(). */
+void
+journal_commit (void)
+{
+  lock_acquire (&journal_lock);
+  wait_idle ();
+  commit_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Returns true if SECTOR has journaled contents that have not
+   reached their home location yet.  The buffer cache must not
+   write such a sector to disk itself. */
+bool
+journal_owns (block_sector_t sector)
+{
+  bool owned;
+
+  lock_acquire (&journal_lock);
+  owned = (find_block (&running, sector) != NULL
+           || find_block (&checkpoint, sector) != NULL);
+  lock_release (&journal_lock);
+  return owned;
+}
+
+/* Copies the newest journaled contents of SECTOR into BUFFER.
+   Returns false if the journal holds no copy of SECTOR. */
+bool
+journal_read (block_sector_t sector, void *buffer)
+{
+  struct journal_block *jb;
+
+  lock_acquire (&journal_lock);
+  jb = find_block (&running, sector);
+  if (jb == NULL || !jb->valid)
+    jb = find_block (&checkpoint, sector);
+  if (jb != NULL)
+    memcpy (buffer, jb->data, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return jb != NULL;
+}
+
+/* Commits the running transaction every JOURNAL_COMMIT_TICKS
+   and checkpoints in the background once the log is half full,
+   so that foreground operations rarely wait for either. */
+static void
+journal_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_COMMIT_TICKS);
+
+      lock_acquire (&journal_lock);
+      wait_idle ();
+      commit_locked ();
+      if (log_head > JOURNAL_LOG_SECTORS / 2)
+        checkpoint_locked ();
+      lock_release (&journal_lock);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Number of sectors reserved for the journal at the end of the
+   file system device: one header sector plus the log itself. */
+#define JOURNAL_SECTORS 256
+
+void journal_init (bool format);
+void journal_done (void);
+block_sector_t journal_first_sector (void);
+
+/* Transactions. */
+void journal_begin (void);
+void journal_end (void);
+void journal_write (block_sector_t, const void *, int sector_ofs, int chunk_size);
+void journal_revoke (block_sector_t);
+void journal_commit (void);
+
+/* Used by the buffer cache. */
+bool journal_owns (block_sector_t);
+bool journal_read (block_sector_t, void *);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,54 @@
+#ifndef __LIB_AIO_H
+#define __LIB_AIO_H
+
+#include <stdint.h>
+
+/* Asynchronous I/O rings, shared between a user process and the
+   kernel.  aio_setup() maps one page laid out as a struct
+   aio_ring into the process.  The process fills submission
+   entries and advances sq_tail; the kernel consumes them from
+   sq_head, and posts one completion entry per submission at
+   cq_tail, which the process consumes from cq_head.  Indexes
+   only ever increase and are taken modulo the ring size. */
+
+/* Number of entries in each ring.  Must be powers of two. */
+#define AIO_SQ_ENTRIES 64
+#define AIO_CQ_ENTRIES 64
+
+/* Operations. */
+enum aio_opcode
+  {
+    AIO_READ,                   /* pread() into buf. */
+    AIO_WRITE                   /* pwrite() from buf. */
+  };
+
+/* Submission entry. */
+struct aio_sqe
+  {
+    uint32_t opcode;            /* One of enum aio_opcode. */
+    int fd;                     /* Open file descriptor. */
+    void *buf;                  /* User buffer. */
+    uint32_t len;               /* Bytes to transfer. */
+    uint32_t offset;            /* File offset. */
+    uint32_t user_data;         /* Copied to the completion entry. */
+  };
+
+/* Completion entry. */
+struct aio_cqe
+  {
+    uint32_t user_data;         /* From the submission entry. */
+    int result;                 /* Bytes transferred, or -1. */
+  };
+
+/* Layout of the shared ring page. */
+struct aio_ring
+  {
+    volatile uint32_t sq_head;  /* Next entry the kernel takes. */
+    volatile uint32_t sq_tail;  /* Next entry the process fills. */
+    volatile uint32_t cq_head;  /* Next entry the process reaps. */
+    volatile uint32_t cq_tail;  /* Next entry the kernel posts. */
+    struct aio_sqe sqes[AIO_SQ_ENTRIES];
+    struct aio_cqe cqes[AIO_CQ_ENTRIES];
+  };
+
+#endif /* lib/aio.h */
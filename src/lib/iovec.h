@@ -0,0 +1,17 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One buffer in a scatter/gather transfer, as passed to the
+   readv() and writev() system calls. */
+struct iovec
+  {
+    void *iov_base;             /* Start of the buffer. */
+    size_t iov_len;             /* Number of bytes in the buffer. */
+  };
+
+/* Maximum number of buffers in a single readv() or writev(). */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
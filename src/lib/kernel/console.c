@@ -1,14 +1,17 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void log_drain (void);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -59,28 +62,127 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* Kernel log.
+
+   Once the drain thread is running, output is not written to the
+   serial port and vga display by the thread that prints it.
+   Instead, each character is appended to a ring buffer, and the
+   drain thread writes the buffer out in the background, so that
+   printing costs no more than a memory copy and does not hold
+   the console lock across slow device I/O.
+
+   The ring is shared without locks: appending and removing a
+   character each happen with interrupts off.  LOG_HEAD and
+   LOG_TAIL count the characters ever appended and removed, so
+   LOG_HEAD - LOG_TAIL characters are waiting to be written.
+   Characters already written stay in the buffer until they are
+   overwritten, which lets console_dump() return recent output.
+
+   A thread that finds the ring full writes it out itself.  An
+   interrupt handler cannot, so its output is dropped instead. */
+static char log_buf[CONSOLE_LOG_SIZE];
+static uint32_t log_head;               /* Next character to append. */
+static uint32_t log_tail;               /* Next character to write. */
+static int64_t log_dropped;             /* Characters lost when full. */
+
+/* The drain thread, or a null pointer until it starts, and
+   whether it is blocked waiting for output. */
+static struct thread *drain_thread;
+static bool drain_sleeping;
+
+/* Serializes writers of the log, so that characters reach the
+   devices in the order they were appended. */
+static struct lock drain_lock;
+
 /* Enable console locking. */
 void
 console_init (void) 
 {
   lock_init (&console_lock);
+  lock_init (&drain_lock);
   use_console_lock = true;
 }
 
+/* Writes out the kernel log whenever it is not empty. */
+static void
+drain_kernel_log (void *aux UNUSED) 
+{
+  drain_thread = thread_current ();
+  for (;;) 
+    {
+      enum intr_level old_level;
+
+      log_drain ();
+
+      old_level = intr_disable ();
+      if (log_head == log_tail) 
+        {
+          drain_sleeping = true;
+          thread_block ();
+        }
+      intr_set_level (old_level);
+    }
+}
+
+/* Starts the thread that writes the kernel log to the console
+   devices.  Until it runs, output is written synchronously.
+   The thread is not started under the MLFQS scheduler, whose
+   load average it would disturb. */
+void
+console_start (void) 
+{
+  if (!thread_mlfqs)
+    thread_create ("klogd", PRI_MIN, drain_kernel_log, NULL);
+}
+
+/* Writes out everything in the kernel log before returning.
+   Called before the machine shuts down. */
+void
+console_flush (void) 
+{
+  log_drain ();
+}
+
 /* Notifies the console that a kernel panic is underway,
    which warns it to avoid trying to take the console lock from
-   now on. */
+   now on.  Output pending in the kernel log is written out, and
+   output from now on is written synchronously. */
 void
 console_panic (void) 
 {
   use_console_lock = false;
+  log_drain ();
+}
+
+/* Copies the most recent output, up to SIZE characters, into
+   BUFFER.  Returns the number of characters copied. */
+size_t
+console_dump (char *buffer, size_t size) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t start;
+  size_t i;
+
+  if (size > CONSOLE_LOG_SIZE)
+    size = CONSOLE_LOG_SIZE;
+  if (size > log_head)
+    size = log_head;
+  start = log_head - size;
+  for (i = 0; i < size; i++)
+    buffer[i] = log_buf[(start + i) % CONSOLE_LOG_SIZE];
+  intr_set_level (old_level);
+
+  return size;
 }
 
 /* Prints console statistics. */
 void
 console_print_stats (void) 
 {
-  printf ("Console: %lld characters output\n", write_cnt);
+  printf ("Console: %lld characters output", write_cnt);
+  if (log_dropped > 0)
+    printf (", %lld dropped", log_dropped);
+  printf ("\n");
 }
 
 /* Acquires the console lock. */
@@ -178,7 +280,70 @@ vprintf_helper (char c, void *char_cnt_)
   putchar_have_lock (c);
 }
 
-/* Writes C to the vga display and serial port.
+/* Removes the oldest character waiting in the kernel log and
+   stores it in *C.  Returns false if the log is empty. */
+static bool
+log_pop (char *c) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool popped = log_head != log_tail;
+
+  if (popped)
+    *c = log_buf[log_tail++ % CONSOLE_LOG_SIZE];
+  intr_set_level (old_level);
+
+  return popped;
+}
+
+/* Writes the kernel log to the vga display and serial port until
+   it is empty. */
+static void
+log_drain (void) 
+{
+  bool locking = !intr_context () && use_console_lock;
+  char c;
+
+  if (locking)
+    lock_acquire (&drain_lock);
+  while (log_pop (&c)) 
+    {
+      serial_putc (c);
+      vga_putc (c);
+    }
+  if (locking)
+    lock_release (&drain_lock);
+}
+
+/* Appends C to the kernel log and wakes up the drain thread. */
+static void
+log_putc (uint8_t c) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (log_head - log_tail == CONSOLE_LOG_SIZE) 
+    {
+      if (intr_context ()) 
+        {
+          log_dropped++;
+          intr_set_level (old_level);
+          return;
+        }
+      intr_set_level (old_level);
+      log_drain ();
+      old_level = intr_disable ();
+    }
+
+  log_buf[log_head++ % CONSOLE_LOG_SIZE] = c;
+  if (drain_sleeping) 
+    {
+      drain_sleeping = false;
+      thread_unblock (drain_thread);
+    }
+  intr_set_level (old_level);
+}
+
+/* Writes C to the vga display and serial port, through the
+   kernel log if the drain thread is running.
    The caller has already acquired the console lock if
    appropriate. */
 static void
@@ -186,6 +351,17 @@ putchar_have_lock (uint8_t c)
 {
   ASSERT (console_locked_by_current_thread ());
   write_cnt++;
-  serial_putc (c);
-  vga_putc (c);
+  if (drain_thread != NULL && use_console_lock) 
+    log_putc (c);
+  else 
+    {
+      /* Keep a copy for console_dump(). */
+      enum intr_level old_level = intr_disable ();
+      log_buf[log_head++ % CONSOLE_LOG_SIZE] = c;
+      log_tail = log_head;
+      intr_set_level (old_level);
+
+      serial_putc (c);
+      vga_putc (c);
+    }
 }
@@ -1,8 +1,16 @@
 #ifndef __LIB_KERNEL_CONSOLE_H
 #define __LIB_KERNEL_CONSOLE_H
 
+#include <stddef.h>
+
+/* Size of the kernel log, in characters.  Must be a power of 2. */
+#define CONSOLE_LOG_SIZE 16384
+
 void console_init (void);
+void console_start (void);
+void console_flush (void);
 void console_panic (void);
 void console_print_stats (void);
+size_t console_dump (char *, size_t);
 
 #endif /* lib/kernel/console.h */
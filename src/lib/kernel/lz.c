@@ -0,0 +1,184 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Returns the 4 bytes at P as a 32-bit integer. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t x;
+  memcpy (&x, p, sizeof x);
+  return x;
+}
+
+/* Hashes 4 bytes of input to an index into the work area. */
+static inline size_t
+hash32 (uint32_t x)
+{
+  return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Stores LENGTH, less the 15 already in a token nibble, at *OP
+   as a run of 255s and a final byte. */
+static uint8_t *
+put_length (uint8_t *op, size_t length)
+{
+  for (length -= 15; length >= 255; length -= 255)
+    *op++ = 255;
+  *op++ = length;
+  return op;
+}
+
+/* Appends a sequence of LIT_CNT literals from LIT, followed by a
+   match of MATCH_LEN bytes OFFSET bytes back unless MATCH_LEN is
+   0, at *OP.  Returns false if it would pass OEND. */
+static bool
+put_sequence (uint8_t **op_, uint8_t *oend, const uint8_t *lit,
+              size_t lit_cnt, size_t offset, size_t match_len)
+{
+  uint8_t *op = *op_;
+  uint8_t *token;
+  size_t need;
+
+  need = 1 + lit_cnt + lit_cnt / 255 + 1;
+  if (match_len > 0)
+    need += 2 + match_len / 255 + 1;
+  if ((size_t) (oend - op) < need)
+    return false;
+
+  token = op++;
+  *token = (lit_cnt < 15 ? lit_cnt : 15) << 4;
+  if (lit_cnt >= 15)
+    op = put_length (op, lit_cnt);
+  memcpy (op, lit, lit_cnt);
+  op += lit_cnt;
+
+  if (match_len > 0)
+    {
+      size_t m = match_len - LZ_MIN_MATCH;
+      *token |= m < 15 ? m : 15;
+      *op++ = offset & 0xff;
+      *op++ = offset >> 8;
+      if (m >= 15)
+        op = put_length (op, m);
+    }
+
+  *op_ = op;
+  return true;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes
+   at DST, using WORK, which must be LZ_WORK_SIZE bytes, as
+   scratch space.  Returns the compressed size, or 0 if it would
+   exceed DST_SIZE. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, void *work)
+{
+  const uint8_t *src = src_;
+  const uint8_t *end = src + src_size;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint16_t *table = work;
+
+  ASSERT (src_size <= LZ_MAX_INPUT);
+
+  memset (table, 0, LZ_WORK_SIZE);
+  while (end - ip >= LZ_MIN_MATCH)
+    {
+      uint32_t seq = read32 (ip);
+      size_t h = hash32 (seq);
+      const uint8_t *ref = src + table[h];
+
+      table[h] = ip - src;
+      if (ref < ip && read32 (ref) == seq)
+        {
+          const uint8_t *mp = ip + LZ_MIN_MATCH;
+          const uint8_t *rp = ref + LZ_MIN_MATCH;
+
+          while (mp < end && *mp == *rp)
+            mp++, rp++;
+          if (!put_sequence (&op, dst + dst_size, anchor, ip - anchor,
+                             ip - ref, mp - ip))
+            return 0;
+          ip = anchor = mp;
+        }
+      else
+        ip++;
+    }
+
+  if (!put_sequence (&op, dst + dst_size, anchor, end - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* Reads a length continuation from *IP, which must not pass
+   IEND, and adds it to *LENGTH.  Returns false on bad input. */
+static bool
+get_length (const uint8_t **ip_, const uint8_t *iend, size_t *length)
+{
+  const uint8_t *ip = *ip_;
+  uint8_t b;
+
+  do
+    {
+      if (ip >= iend)
+        return false;
+      b = *ip++;
+      *length += b;
+    }
+  while (b == 255);
+  *ip_ = ip;
+  return true;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes
+   at DST.  Returns the decompressed size, or 0 if SRC is not
+   valid compressed data or does not fit in DST. */
+size_t
+lz_decompress (const void *src, size_t src_size,
+               void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src;
+  const uint8_t *iend = ip + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + dst_size;
+
+  while (ip < iend)
+    {
+      uint8_t token = *ip++;
+      size_t lit_cnt = token >> 4;
+      size_t match_len = token & 15;
+      size_t offset;
+
+      if (lit_cnt == 15 && !get_length (&ip, iend, &lit_cnt))
+        return 0;
+      if (lit_cnt > (size_t) (iend - ip) || lit_cnt > (size_t) (oend - op))
+        return 0;
+      memcpy (op, ip, lit_cnt);
+      ip += lit_cnt;
+      op += lit_cnt;
+      if (ip == iend)
+        break;
+
+      if (iend - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == 15 && !get_length (&ip, iend, &match_len))
+        return 0;
+      match_len += LZ_MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || match_len > (size_t) (oend - op))
+        return 0;
+
+      /* The match may overlap the bytes it produces. */
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  return op - dst;
+}
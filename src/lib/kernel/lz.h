@@ -0,0 +1,33 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fast LZ77 compression, in the style of LZ4.
+
+   The compressed data is a series of sequences.  Each starts
+   with a token byte whose high nibble is the number of literal
+   bytes that follow and whose low nibble is the length of the
+   match after them, less LZ_MIN_MATCH.  A nibble of 15 is
+   continued by bytes of 255 and a final byte less than 255, all
+   added to it.  The literals come next, then a 2-byte,
+   little-endian offset back to the match, then the match length
+   continuation, if any.  The last sequence has only literals.
+
+   Inputs are limited to LZ_MAX_INPUT bytes, so that offsets fit
+   in 16 bits. */
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_INPUT 65535
+
+/* Size of the work area that lz_compress() needs. */
+#define LZ_HASH_BITS 12
+#define LZ_WORK_SIZE ((1 << LZ_HASH_BITS) * sizeof (uint16_t))
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
@@ -28,7 +28,22 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write several buffers to a file. */
+    SYS_PREAD,                  /* Read from a file at a given offset. */
+    SYS_PWRITE,                 /* Write to a file at a given offset. */
+    SYS_COPY_FILE_RANGE,        /* Copy data between files in the kernel. */
+    SYS_FSYNC,                  /* Write a file's data to disk. */
+    SYS_SYNC,                   /* Write all cached data to disk. */
+    SYS_AIO_SETUP,              /* Map asynchronous I/O rings. */
+    SYS_AIO_ENTER,              /* Submit and reap asynchronous I/O. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DMESG,                  /* Read recent kernel output. */
+    SYS_FORK,                   /* Duplicate the current process. */
+    SYS_MSYNC                   /* Write back a memory mapping. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <iovec.h>
+#include <aio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,22 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+int fsync (int fd);
+void sync (void);
+int aio_setup (struct aio_ring *ring);
+int aio_enter (unsigned to_submit, unsigned min_complete);
+int pipe (int fds[2]);
+int dmesg (char *buffer, unsigned size);
+pid_t fork (void);
+int msync (mapid_t);
+
+/* Used by the C startup code. */
+void syscall_select_entry (void);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,82 @@
+/* Writes a file in pieces through the asynchronous I/O rings,
+   reads it back the same way, and checks every completion and
+   the final contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PIECES 8
+
+static struct aio_ring *ring = (struct aio_ring *) 0x20000000;
+static char buf[sizeof sample];
+
+/* Queues one request for byte range I of the sample. */
+static void
+queue (int handle, enum aio_opcode opcode, void *base, int i)
+{
+  size_t piece = (sizeof sample - 1 + PIECES - 1) / PIECES;
+  size_t ofs = i * piece;
+  size_t len = ofs + piece <= sizeof sample - 1 ? piece : sizeof sample - 1 - ofs;
+  struct aio_sqe *sqe = &ring->sqes[ring->sq_tail % AIO_SQ_ENTRIES];
+
+  sqe->opcode = opcode;
+  sqe->fd = handle;
+  sqe->buf = (char *) base + ofs;
+  sqe->len = len;
+  sqe->offset = ofs;
+  sqe->user_data = i;
+  ring->sq_tail++;
+}
+
+/* Submits PIECES requests and checks their completions. */
+static void
+run (int handle, enum aio_opcode opcode, void *base)
+{
+  bool seen[PIECES];
+  int i, submitted;
+
+  for (i = 0; i < PIECES; i++)
+    queue (handle, opcode, base, i);
+  submitted = aio_enter (PIECES, PIECES);
+  if (submitted != PIECES)
+    fail ("aio_enter() submitted %d instead of %d", submitted, PIECES);
+  if (ring->cq_tail - ring->cq_head != PIECES)
+    fail ("%u completions instead of %d",
+          ring->cq_tail - ring->cq_head, PIECES);
+
+  memset (seen, 0, sizeof seen);
+  while (ring->cq_head != ring->cq_tail)
+    {
+      struct aio_cqe *cqe = &ring->cqes[ring->cq_head % AIO_CQ_ENTRIES];
+      if (cqe->user_data >= PIECES || seen[cqe->user_data])
+        fail ("bad completion for request %u", cqe->user_data);
+      if (cqe->result <= 0)
+        fail ("request %u returned %d", cqe->user_data, cqe->result);
+      seen[cqe->user_data] = true;
+      ring->cq_head++;
+    }
+}
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK (create ("test.txt", sizeof sample - 1), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (aio_setup (ring) == 0, "aio_setup");
+
+  msg ("write %d pieces", PIECES);
+  run (handle, AIO_WRITE, sample);
+  msg ("read %d pieces", PIECES);
+  run (handle, AIO_READ, buf);
+  if (memcmp (buf, sample, sizeof sample - 1))
+    fail ("read data differs from written data");
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
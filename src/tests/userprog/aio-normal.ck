@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-normal) begin
+(aio-normal) create "test.txt"
+(aio-normal) open "test.txt"
+(aio-normal) aio_setup
+(aio-normal) write 8 pieces
+(aio-normal) read 8 pieces
+(aio-normal) close "test.txt"
+(aio-normal) open "test.txt" for verification
+(aio-normal) verified contents of "test.txt"
+(aio-normal) close "test.txt"
+(aio-normal) end
+aio-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Writes a file from a buffer inside the asynchronous I/O ring
+   page itself, which the kernel must pin like any other user
+   page, and checks that the file holds the ring's bytes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LEN 64
+
+static struct aio_ring *ring = (struct aio_ring *) 0x20000000;
+
+void
+test_main (void) 
+{
+  struct aio_sqe *sqe;
+  struct aio_cqe *cqe;
+  char *data = (char *) &ring->sqes[1];
+  char copy[LEN];
+  int handle;
+
+  CHECK (create ("test.txt", LEN), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (aio_setup (ring) == 0, "aio_setup");
+
+  memset (data, 'r', LEN);
+  memcpy (copy, data, LEN);
+  sqe = &ring->sqes[ring->sq_tail % AIO_SQ_ENTRIES];
+  sqe->opcode = AIO_WRITE;
+  sqe->fd = handle;
+  sqe->buf = data;
+  sqe->len = LEN;
+  sqe->offset = 0;
+  sqe->user_data = 7;
+  ring->sq_tail++;
+  CHECK (aio_enter (1, 1) == 1, "write from the ring");
+
+  cqe = &ring->cqes[ring->cq_head % AIO_CQ_ENTRIES];
+  if (cqe->user_data != 7 || cqe->result != LEN)
+    fail ("completion %u returned %d", cqe->user_data, cqe->result);
+  ring->cq_head++;
+  close (handle);
+
+  check_file ("test.txt", copy, LEN);
+}
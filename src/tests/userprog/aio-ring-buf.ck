@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-ring-buf) begin
+(aio-ring-buf) create "test.txt"
+(aio-ring-buf) open "test.txt"
+(aio-ring-buf) aio_setup
+(aio-ring-buf) write from the ring
+(aio-ring-buf) open "test.txt" for verification
+(aio-ring-buf) verified contents of "test.txt"
+(aio-ring-buf) close "test.txt"
+(aio-ring-buf) end
+aio-ring-buf: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Child process run by pipe-exec test.
+
+   Writes sample text to the pipe write end inherited from its
+   parent, whose file descriptor is passed as the first
+   command-line argument. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe";
+
+int
+main (int argc UNUSED, char *argv[]) 
+{
+  if (!isdigit (*argv[1]))
+    fail ("bad command-line arguments");
+  if (write (atoi (argv[1]), sample, sizeof sample - 1)
+      != (int) sizeof sample - 1)
+    fail ("write to inherited pipe failed");
+
+  return 0;
+}
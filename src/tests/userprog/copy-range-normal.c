@@ -0,0 +1,29 @@
+/* Copies a file with copy_file_range() and checks that both
+   file positions advance by the number of bytes copied. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int in_fd, out_fd, byte_cnt;
+
+  CHECK ((in_fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((out_fd = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = copy_file_range (in_fd, out_fd, sizeof sample - 1);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("copy_file_range() returned %d instead of %zu",
+          byte_cnt, sizeof sample - 1);
+  CHECK (tell (in_fd) == sizeof sample - 1
+         && tell (out_fd) == sizeof sample - 1,
+         "file positions advanced by copy");
+  msg ("close \"test.txt\"");
+  close (out_fd);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,26 @@
+/* Tries to copy a file onto itself with copy_file_range(), which
+   must fail without changing the file or its position, and copies
+   nothing onto itself, which must succeed. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (copy_file_range (fd, fd, sizeof sample - 1) == -1,
+         "copy_file_range onto itself fails");
+  CHECK (tell (fd) == 0, "file position unchanged");
+  CHECK (copy_file_range (fd, fd, 0) == 0,
+         "copy_file_range of 0 bytes onto itself");
+  CHECK (tell (fd) == 0, "file position unchanged");
+  msg ("close \"sample.txt\"");
+  close (fd);
+
+  check_file ("sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range-same) begin
+(copy-range-same) open "sample.txt"
+(copy-range-same) copy_file_range onto itself fails
+(copy-range-same) file position unchanged
+(copy-range-same) copy_file_range of 0 bytes onto itself
+(copy-range-same) file position unchanged
+(copy-range-same) close "sample.txt"
+(copy-range-same) open "sample.txt" for verification
+(copy-range-same) verified contents of "sample.txt"
+(copy-range-same) close "sample.txt"
+(copy-range-same) end
+copy-range-same: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Prints a message and checks that dmesg() returns it as part of
+   the most recent kernel output. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buffer[4096];
+
+void
+test_main (void) 
+{
+  const char *marker = "(dmesg-normal) marker";
+  int bytes;
+
+  msg ("marker");
+  bytes = dmesg (buffer, sizeof buffer - 1);
+  if (bytes <= 0 || bytes > (int) sizeof buffer - 1)
+    fail ("dmesg() returned %d", bytes);
+  buffer[bytes] = '\0';
+  if (strstr (buffer, marker) == NULL)
+    fail ("kernel log lacks \"%s\"", marker);
+  msg ("found marker");
+  CHECK (dmesg (buffer, 0) == 0, "dmesg into empty buffer");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dmesg-normal) begin
+(dmesg-normal) marker
+(dmesg-normal) found marker
+(dmesg-normal) dmesg into empty buffer
+(dmesg-normal) end
+dmesg-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,28 @@
+/* Writes a file, flushes it with fsync() and sync(), and checks
+   that fsync() rejects a bad fd and that the file is intact. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = write (handle, sample, sizeof sample - 1);
+  if (byte_cnt != (int) sizeof sample - 1)
+    fail ("write() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  CHECK (fsync (handle) == 0, "fsync \"test.txt\"");
+  CHECK (fsync (handle + 100) == -1, "fsync bad fd");
+  msg ("sync");
+  sync ();
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
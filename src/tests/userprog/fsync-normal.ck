@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsync-normal) begin
+(fsync-normal) create "test.txt"
+(fsync-normal) open "test.txt"
+(fsync-normal) fsync "test.txt"
+(fsync-normal) fsync bad fd
+(fsync-normal) sync
+(fsync-normal) close "test.txt"
+(fsync-normal) open "test.txt" for verification
+(fsync-normal) verified contents of "test.txt"
+(fsync-normal) close "test.txt"
+(fsync-normal) end
+fsync-normal: exit(0)
+EOF
+pass;
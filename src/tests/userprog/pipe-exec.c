@@ -0,0 +1,36 @@
+/* Creates a pipe and runs child-pipe, which inherits the pipe
+   and writes sample text into the write end passed on its
+   command line.  The parent then reads the text back. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char cmd_line[128];
+  char buffer[sizeof sample];
+  int fds[2];
+  int byte_cnt, total;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  snprintf (cmd_line, sizeof cmd_line, "child-pipe %d", fds[1]);
+  pid = exec (cmd_line);
+  close (fds[1]);
+  if (wait (pid) != 0)
+    fail ("child-pipe failed");
+
+  total = 0;
+  while ((byte_cnt = read (fds[0], buffer + total, sizeof buffer - total)) > 0)
+    total += byte_cnt;
+  if (total != (int) sizeof sample - 1)
+    fail ("read %d bytes instead of %zu", total, sizeof sample - 1);
+  if (memcmp (buffer, sample, total))
+    fail ("data read from pipe differs from data written");
+  msg ("read from child");
+}
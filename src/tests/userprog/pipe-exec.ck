@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+child-pipe: exit(0)
+(pipe-exec) read from child
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
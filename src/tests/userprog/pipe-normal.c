@@ -0,0 +1,36 @@
+/* Writes sample text into a pipe, reads it back, and checks that
+   the read end sees end of file once the write end is closed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buffer[sizeof sample];
+  int fds[2];
+  int byte_cnt;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (fds[0] > 1 && fds[1] > 1 && fds[0] != fds[1], "distinct fds");
+
+  byte_cnt = write (fds[1], sample, sizeof sample - 1);
+  if (byte_cnt != (int) sizeof sample - 1)
+    fail ("write() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  CHECK (read (fds[1], buffer, 1) == -1, "read from write end");
+
+  byte_cnt = read (fds[0], buffer, sizeof buffer);
+  if (byte_cnt != (int) sizeof sample - 1)
+    fail ("read() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  if (memcmp (buffer, sample, byte_cnt))
+    fail ("data read from pipe differs from data written");
+
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (read (fds[0], buffer, sizeof buffer) == 0, "read at end of file");
+  msg ("close read end");
+  close (fds[0]);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-normal) begin
+(pipe-normal) pipe
+(pipe-normal) distinct fds
+(pipe-normal) read from write end
+(pipe-normal) close write end
+(pipe-normal) read at end of file
+(pipe-normal) close read end
+(pipe-normal) end
+pipe-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Reads from the middle of a file with pread() and checks that
+   the file position was left alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buffer[32];
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  byte_cnt = pread (handle, buffer, sizeof buffer, 100);
+  if (byte_cnt != sizeof buffer)
+    fail ("pread() returned %d instead of %zu", byte_cnt, sizeof buffer);
+  if (memcmp (buffer, sample + 100, sizeof buffer))
+    fail ("data read at offset 100 differs from \"sample.txt\"");
+  CHECK (tell (handle) == 0, "file position unchanged by pread");
+
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-normal) begin
+(pread-normal) open "sample.txt"
+(pread-normal) file position unchanged by pread
+(pread-normal) verified contents of "sample.txt"
+(pread-normal) end
+pread-normal: exit(0)
+EOF
+pass;
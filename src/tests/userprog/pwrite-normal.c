@@ -0,0 +1,30 @@
+/* Writes the two halves of a file in reverse order with
+   pwrite() and checks that the file ends up intact. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t half = (sizeof sample - 1) / 2;
+  size_t rest = sizeof sample - 1 - half;
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = pwrite (handle, sample + half, rest, half);
+  if (byte_cnt != (int) rest)
+    fail ("pwrite() returned %d instead of %zu", byte_cnt, rest);
+  byte_cnt = pwrite (handle, sample, half, 0);
+  if (byte_cnt != (int) half)
+    fail ("pwrite() returned %d instead of %zu", byte_cnt, half);
+  CHECK (tell (handle) == 0, "file position unchanged by pwrite");
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,38 @@
+/* Reads a file into three buffers with a single readv() call
+   and checks that the pieces line up with the file's contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char head[16];
+static char middle[64];
+static char tail[sizeof sample];
+
+void
+test_main (void) 
+{
+  struct iovec iov[3];
+  size_t tail_size = sizeof sample - 1 - sizeof head - sizeof middle;
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = middle;
+  iov[1].iov_len = sizeof middle;
+  iov[2].iov_base = tail;
+  iov[2].iov_len = sizeof tail;
+  byte_cnt = readv (handle, iov, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+
+  if (memcmp (head, sample, sizeof head)
+      || memcmp (middle, sample + sizeof head, sizeof middle)
+      || memcmp (tail, sample + sizeof head + sizeof middle, tail_size))
+    fail ("scattered data differs from \"sample.txt\"");
+  msg ("verified scattered contents of \"sample.txt\"");
+}
@@ -0,0 +1,37 @@
+/* Writes a header and a payload with a single writev() call,
+   then reads the file back to check that they were gathered in
+   order. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char header[] = "header:";
+
+void
+test_main (void) 
+{
+  struct iovec iov[2];
+  size_t size = sizeof header - 1 + sizeof sample - 1;
+  char expected[sizeof header - 1 + sizeof sample - 1];
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = header;
+  iov[0].iov_len = sizeof header - 1;
+  iov[1].iov_base = sample;
+  iov[1].iov_len = sizeof sample - 1;
+  byte_cnt = writev (handle, iov, 2);
+  if (byte_cnt != (int) size)
+    fail ("writev() returned %d instead of %zu", byte_cnt, size);
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  memcpy (expected, header, sizeof header - 1);
+  memcpy (expected + sizeof header - 1, sample, sizeof sample - 1);
+  check_file ("test.txt", expected, size);
+}
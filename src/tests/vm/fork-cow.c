@@ -0,0 +1,44 @@
+/* Forks a child that checks it sees the parent's memory and then
+   overwrites it, and verifies that the parent's copy is
+   unchanged. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t pid;
+  size_t i;
+
+  msg ("initialize");
+  memset (buf, 0x5a, sizeof buf);
+
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 0x5a)
+          exit (1);
+      memset (buf, 0xa5, sizeof buf);
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != (char) 0xa5)
+          exit (2);
+      exit (81);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  CHECK (wait (pid) == 81, "wait for child");
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu != 0x5a", i);
+}
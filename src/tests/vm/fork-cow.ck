@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) initialize
+(fork-cow) fork
+fork-cow: exit(81)
+(fork-cow) wait for child
+(fork-cow) read pass
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,28 @@
+/* Touches one page in every megabyte of a 256 MB BSS array.  The
+   array is reserved as a single range, so loading the program
+   must not allocate anything per page of it. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (256 * 1024 * 1024)
+#define STRIDE (1024 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("write pass");
+  for (i = 0; i < SIZE; i += STRIDE)
+    buf[i] = i / STRIDE;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i += STRIDE)
+    if (buf[i] != (char) (i / STRIDE))
+      fail ("byte %zu has wrong value", i);
+  if (buf[SIZE - 1] != 0)
+    fail ("last byte != 0");
+}
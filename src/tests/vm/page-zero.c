@@ -0,0 +1,32 @@
+/* Reads a large BSS array that has never been written, then
+   writes every other page of it and verifies that the rest still
+   reads as zeros. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define PAGE 4096
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+
+  msg ("write pass");
+  for (i = 0; i < SIZE; i += 2 * PAGE)
+    memset (buf + i, 0x5a, PAGE);
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (i / PAGE % 2 == 0 ? 0x5a : 0))
+      fail ("byte %zu has wrong value", i);
+}
@@ -33,6 +33,7 @@
 #endif
 #ifdef VM
 #include "vm/frame.h"
+#include "vm/page.h"
 #include "vm/swap.h"
 #endif
 #ifdef FILESYS
@@ -111,6 +112,7 @@ main (void)
 #endif
 #ifdef VM
   frame_init ();
+  sup_page_init ();
 #endif
   /* Initialize interrupt handlers. */
   intr_init ();
@@ -124,6 +126,7 @@ main (void)
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
+  console_start ();
   timer_calibrate ();
 
 #ifdef FILESYS
@@ -136,6 +139,7 @@ main (void)
 
 #ifdef VM
   swap_init ();
+  frame_start_pageout ();
 #endif
 
   printf ("Boot complete.\n");
@@ -267,9 +271,30 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-bps"))
+        {
+          int bps = atoi (value);
+          if (bps < 300 || bps > 115200 || 115200 % bps != 0)
+            PANIC ("bad serial speed `%s' (use -h for help)", value);
+          serial_set_bps (bps);
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-evict"))
+        {
+          if (value == NULL || !frame_set_policy (value))
+            PANIC ("unknown eviction policy `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-fault-around"))
+        {
+          if (value == NULL || !sup_page_set_fault_around (atoi (value)))
+            PANIC ("bad fault-around window `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -390,8 +415,15 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -bps=BPS           Run the serial port at BPS bits/s (115200).\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -evict=POLICY      Evict pages by POLICY: clock (default),\n"
+          "                     clock2, aging, or lru.\n"
+          "  -fault-around=N    Load up to N pages of a file per fault\n"
+          "                     (8 by default, 1 to disable).\n"
 #endif
           );
   shutdown_power_off ();
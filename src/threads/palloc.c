@@ -148,6 +148,15 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of pages in the user pool and stores the
+   address of its first page in *BASE. */
+size_t
+palloc_user_pool (uint8_t **base)
+{
+  *base = user_pool.base;
+  return bitmap_size (user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -18,6 +18,7 @@
 
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/pipe.h"
 #include "userprog/syscall.h"
 #endif
 
@@ -194,7 +195,10 @@ free_fds (void)
   while (!list_empty(&t->fds)) {
     e = list_pop_front(&t->fds);
     fd_info = list_entry (e, struct file_descriptor, elem);
-    file_close (fd_info->file);
+    if (fd_info->pipe != NULL)
+      pipe_close (fd_info->pipe, fd_info->write_end);
+    else
+      file_close (fd_info->file);
     free (fd_info);
   }
   sema_up_filesys ();
@@ -226,13 +230,10 @@ free_mmap_one(mapid_t mapid)
     return false;
   }
   
-  void * page_start;
-  size_t written_size;
   for(int file_ofs = 0; file_ofs < (mdesc->size); file_ofs=file_ofs+PGSIZE){
-    page_start = mdesc->address + file_ofs;
-    written_size = (mdesc->size - file_ofs > PGSIZE ? PGSIZE : mdesc->size - file_ofs);
-    sup_page_unmap(page_start, written_size, file_ofs);
+    sup_page_unmap(mdesc->address + file_ofs);
   }
+  sup_page_release_range(mdesc->address);
   file_close(mdesc->file);
   list_remove(&mdesc->elem);
   free(mdesc);
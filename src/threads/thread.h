@@ -33,6 +33,8 @@ struct file_descriptor {
     int fd;
     struct dir* dir;
     struct file *file;
+    struct pipe *pipe;          /* Pipe end, or NULL. */
+    bool write_end;             /* Whether PIPE is the write end. */
     struct list_elem elem;
 };
 
@@ -117,11 +119,14 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct aio_context *aio;            /* Asynchronous I/O rings. */
+    struct intr_frame *syscall_frame;   /* System call in progress. */
 #endif
 
     uint8_t *esp;
 #ifdef VM
     struct hash *spt;
+    struct vma_table vmas;
     struct list map_list;
 #endif
     struct dir* cur_dir;                    /* current directory */
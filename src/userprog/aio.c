@@ -0,0 +1,400 @@
+#include "userprog/aio.h"
+#include <aio.h>
+#include <debug.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Number of kernel threads that carry out requests. */
+#define AIO_WORKERS 4
+
+/* A process's rings and the requests it has in flight. */
+struct aio_context
+  {
+    struct aio_ring *ring;      /* Kernel address of the ring page. */
+    void *uring;                /* User address of the ring page. */
+    uint32_t *pagedir;          /* Owning process's page directory. */
+    struct lock lock;           /* Protects the fields below. */
+    struct condition completed; /* Signaled on every completion. */
+    unsigned inflight;          /* Submitted, not yet completed. */
+    struct list done;           /* Completed, not yet released. */
+  };
+
+/* One submitted operation. */
+struct aio_request
+  {
+    struct list_elem elem;      /* In work_queue, then ctx->done. */
+    struct aio_context *ctx;    /* Submitting process. */
+    struct aio_sqe sqe;         /* Copy of the submission entry. */
+    struct file *file;          /* Private handle on sqe.fd's file. */
+  };
+
+static struct list work_queue;      /* Requests awaiting a worker. */
+static struct lock work_lock;       /* Protects work_queue. */
+static struct condition work_ready; /* Signaled when work is queued. */
+static bool workers_started;
+
+static void aio_worker (void *aux UNUSED);
+
+/* Initializes the asynchronous I/O module.  Worker threads are
+   started by the first aio_setup(). */
+void
+aio_init (void)
+{
+  list_init (&work_queue);
+  lock_init (&work_lock);
+  cond_init (&work_ready);
+  workers_started = false;
+}
+
+/* Maps a zeroed ring page at user address URING, which must be
+   page-aligned and not yet mapped, and makes it the current
+   process's ring.  Returns 0 if successful, -1 otherwise. */
+int
+aio_setup (void *uring)
+{
+  struct thread *cur = thread_current ();
+  struct aio_context *ctx;
+  int i;
+
+  ASSERT (sizeof (struct aio_ring) <= PGSIZE);
+
+  if (cur->aio != NULL || uring == NULL || pg_ofs (uring) != 0
+      || !is_user_vaddr (uring)
+      || pagedir_get_page (cur->pagedir, uring) != NULL)
+    return -1;
+#ifdef VM
+  if (sup_page_table_has_entry (cur->spt, uring))
+    return -1;
+#endif
+
+  ctx = malloc (sizeof *ctx);
+  if (ctx == NULL)
+    return -1;
+#ifdef VM
+  /* The ring is a zero page of the address space like any other,
+     so that pinning, mmap() and fork() all see it, kept pinned
+     while the ring exists. */
+  if (!sup_page_install_zero_page (uring))
+    {
+      free (ctx);
+      return -1;
+    }
+  if (!sup_page_load_page_and_pin (uring, true, false))
+    {
+      sup_page_unmap (uring);
+      free (ctx);
+      return -1;
+    }
+  ctx->ring = (struct aio_ring *)
+    sup_page_table_get_entry (cur->spt, uring)->kpage;
+#else
+  ctx->ring = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (ctx->ring == NULL
+      || !pagedir_set_page (cur->pagedir, uring, ctx->ring, true))
+    {
+      palloc_free_page (ctx->ring);
+      free (ctx);
+      return -1;
+    }
+#endif
+  ctx->uring = uring;
+  ctx->pagedir = cur->pagedir;
+  lock_init (&ctx->lock);
+  cond_init (&ctx->completed);
+  ctx->inflight = 0;
+  list_init (&ctx->done);
+  cur->aio = ctx;
+
+  lock_acquire (&work_lock);
+  if (!workers_started)
+    {
+      for (i = 0; i < AIO_WORKERS; i++)
+        thread_create ("aio", PRI_DEFAULT, aio_worker, NULL);
+      workers_started = true;
+    }
+  lock_release (&work_lock);
+  return 0;
+}
+
+/* Posts a completion with RESULT for SQE to CTX's ring.  CTX's
+   lock must be held. */
+static void
+post_completion (struct aio_context *ctx, const struct aio_sqe *sqe,
+                 int result)
+{
+  struct aio_ring *ring = ctx->ring;
+  struct aio_cqe *cqe = &ring->cqes[ring->cq_tail % AIO_CQ_ENTRIES];
+
+  ASSERT (lock_held_by_current_thread (&ctx->lock));
+  cqe->user_data = sqe->user_data;
+  cqe->result = result;
+  barrier ();
+  ring->cq_tail++;
+  cond_broadcast (&ctx->completed, &ctx->lock);
+}
+
+/* Releases the pages and file held by every completed request
+   of CTX.  Must run in the owning process. */
+static void
+release_done (struct aio_context *ctx)
+{
+  struct list done;
+
+  list_init (&done);
+  lock_acquire (&ctx->lock);
+  while (!list_empty (&ctx->done))
+    list_push_back (&done, list_pop_front (&ctx->done));
+  lock_release (&ctx->lock);
+
+  while (!list_empty (&done))
+    {
+      struct aio_request *req = list_entry (list_pop_front (&done),
+                                            struct aio_request, elem);
+#ifdef VM
+      sup_page_unpin_range (req->sqe.buf, req->sqe.len);
+#endif
+      sema_down_filesys ();
+      file_close (req->file);
+      sema_up_filesys ();
+      free (req);
+    }
+}
+
+/* Checks that the LEN bytes at BUF are user memory the workers
+   can reach, and can write if WRITABLE, pinning them under VM.
+   Returns false if not.  Workers write through the kernel
+   mapping, which ignores the user's page protections, and a
+   read-only page may be shared with other processes. */
+static bool
+prepare_buffer (void *buf, uint32_t len, bool writable)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  void *upage;
+
+  if (len == 0)
+    return true;
+  if (buf == NULL || !is_user_vaddr (buf) || !is_user_vaddr (buf + len - 1)
+      || buf + len < buf)
+    return false;
+#ifdef VM
+  if (!sup_page_pin_range (buf, len))
+    return false;
+#endif
+  for (upage = pg_round_down (buf); upage < buf + len; upage += PGSIZE)
+    if (pagedir_get_page (pd, upage) == NULL
+        || (writable && !pagedir_is_writable (pd, upage)))
+      {
+#ifdef VM
+        sup_page_unpin_range (buf, len);
+#endif
+        return false;
+      }
+  return true;
+}
+
+/* Turns SQE into a request and queues it for the workers.
+   Completes it at once with -1 if it is malformed. */
+static void
+submit_one (struct aio_context *ctx, const struct aio_sqe *sqe)
+{
+  struct aio_request *req;
+  struct file *file;
+
+  req = malloc (sizeof *req);
+  if (req == NULL)
+    goto fail;
+  req->ctx = ctx;
+  req->sqe = *sqe;
+
+  sema_down_filesys ();
+  file = find_file (sqe->fd);
+  req->file = (file != NULL && !inode_is_dir (file_get_inode (file))
+               ? file_reopen (file) : NULL);
+  sema_up_filesys ();
+
+  if (req->file == NULL
+      || (sqe->opcode != AIO_READ && sqe->opcode != AIO_WRITE)
+      || (off_t) sqe->offset < 0
+      || !prepare_buffer (sqe->buf, sqe->len, sqe->opcode == AIO_READ))
+    {
+      if (req->file != NULL)
+        {
+          sema_down_filesys ();
+          file_close (req->file);
+          sema_up_filesys ();
+        }
+      free (req);
+      goto fail;
+    }
+
+  lock_acquire (&ctx->lock);
+  ctx->inflight++;
+  lock_release (&ctx->lock);
+
+  lock_acquire (&work_lock);
+  list_push_back (&work_queue, &req->elem);
+  cond_signal (&work_ready, &work_lock);
+  lock_release (&work_lock);
+  return;
+
+ fail:
+  lock_acquire (&ctx->lock);
+  post_completion (ctx, sqe, -1);
+  lock_release (&ctx->lock);
+}
+
+/* Submits up to TO_SUBMIT entries from the current process's
+   submission ring, then waits until at least MIN_COMPLETE
+   completions are waiting to be reaped or nothing is left in
+   flight.  Submission stops early rather than let completions
+   overrun the completion ring.  Returns the number of entries
+   consumed, or -1 if the process has no ring. */
+int
+aio_enter (unsigned to_submit, unsigned min_complete)
+{
+  struct aio_context *ctx = thread_current ()->aio;
+  struct aio_ring *ring;
+  unsigned submitted = 0;
+
+  if (ctx == NULL)
+    return -1;
+  ring = ctx->ring;
+  release_done (ctx);
+
+  while (submitted < to_submit && ring->sq_head != ring->sq_tail)
+    {
+      struct aio_sqe sqe;
+      unsigned pending;
+
+      lock_acquire (&ctx->lock);
+      pending = ctx->inflight + (ring->cq_tail - ring->cq_head);
+      lock_release (&ctx->lock);
+      if (pending >= AIO_CQ_ENTRIES)
+        break;
+
+      sqe = ring->sqes[ring->sq_head % AIO_SQ_ENTRIES];
+      barrier ();
+      ring->sq_head++;
+      submit_one (ctx, &sqe);
+      submitted++;
+    }
+
+  lock_acquire (&ctx->lock);
+  while (ring->cq_tail - ring->cq_head < min_complete && ctx->inflight > 0)
+    cond_wait (&ctx->completed, &ctx->lock);
+  lock_release (&ctx->lock);
+
+  return submitted;
+}
+
+/* Waits for the current process's requests to finish and
+   unmaps its ring.  Called on process exit. */
+void
+aio_exit (void)
+{
+  struct thread *cur = thread_current ();
+  struct aio_context *ctx = cur->aio;
+
+  if (ctx == NULL)
+    return;
+
+  lock_acquire (&ctx->lock);
+  while (ctx->inflight > 0)
+    cond_wait (&ctx->completed, &ctx->lock);
+  lock_release (&ctx->lock);
+  release_done (ctx);
+
+#ifdef VM
+  /* The page goes with the rest of the address space. */
+  sup_page_update_frame_pinned (ctx->uring, false);
+#else
+  pagedir_clear_page (ctx->pagedir, ctx->uring);
+  palloc_free_page (ctx->ring);
+#endif
+  cur->aio = NULL;
+  free (ctx);
+}
+
+/* Carries out REQ through the buffer cache, a page at a time,
+   reaching the pinned user buffer through its kernel mapping.
+   Writes through that mapping do not set the dirty bit of the
+   user's page, so reads set it themselves; otherwise a page of
+   a memory-mapped file could be dropped instead of written
+   back.  The file system lock is taken for one page at a time,
+   so that the workers and other file system calls can run
+   between the pages of a large request.  Returns the number of
+   bytes transferred. */
+static int
+do_request (struct aio_request *req)
+{
+  uint8_t *ubuf = req->sqe.buf;
+  off_t offset = req->sqe.offset;
+  uint32_t left = req->sqe.len;
+  int result = 0;
+
+  while (left > 0)
+    {
+      size_t page_left = PGSIZE - pg_ofs (ubuf);
+      off_t chunk = left < page_left ? left : page_left;
+      void *kbuf = pagedir_get_page (req->ctx->pagedir, ubuf);
+      off_t bytes;
+
+      if (kbuf == NULL)
+        break;
+      sema_down_filesys ();
+      bytes = (req->sqe.opcode == AIO_READ
+               ? file_read_at (req->file, kbuf, chunk, offset)
+               : file_write_at (req->file, kbuf, chunk, offset));
+      sema_up_filesys ();
+      if (req->sqe.opcode == AIO_READ && bytes > 0)
+        pagedir_set_dirty (req->ctx->pagedir, ubuf, true);
+      result += bytes;
+      if (bytes != chunk)
+        break;
+      ubuf += chunk;
+      offset += chunk;
+      left -= chunk;
+    }
+  return result;
+}
+
+/* Worker thread: runs queued requests and posts their
+   completions. */
+static void
+aio_worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct aio_request *req;
+      struct aio_context *ctx;
+      int result;
+
+      lock_acquire (&work_lock);
+      while (list_empty (&work_queue))
+        cond_wait (&work_ready, &work_lock);
+      req = list_entry (list_pop_front (&work_queue),
+                        struct aio_request, elem);
+      lock_release (&work_lock);
+
+      result = do_request (req);
+
+      ctx = req->ctx;
+      lock_acquire (&ctx->lock);
+      post_completion (ctx, &req->sqe, result);
+      list_push_back (&ctx->done, &req->elem);
+      ctx->inflight--;
+      lock_release (&ctx->lock);
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+void aio_init (void);
+int aio_setup (void *uring);
+int aio_enter (unsigned to_submit, unsigned min_complete);
+void aio_exit (void);
+
+#endif /* userprog/aio.h */
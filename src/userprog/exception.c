@@ -15,6 +15,21 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static bool exception_fixup (struct intr_frame *);
+
+/* Exception table entry: the kernel instruction at INSN may
+   fault on a user address, in which case execution resumes at
+   FIXUP.  Entries are emitted into section __ex_table by the
+   user memory accessors in userprog/uaccess.c. */
+struct exception_table_entry
+  {
+    uintptr_t insn;
+    uintptr_t fixup;
+  };
+
+/* Bounds of the exception table, from the linker script. */
+extern const struct exception_table_entry _start_ex_table[];
+extern const struct exception_table_entry _end_ex_table[];
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -180,6 +195,10 @@ page_fault (struct intr_frame *f)
    * Check if
    * 1. Check if stack growth is caused by PUSH or PUSHA
    * 2. Absolute limit on stack size (8MB)
+   *
+   * Writing a read only page is fine if it is shared copy-on-write
+   * after fork(); copy it then.  Likewise if it is the zero page,
+   * which reads of untouched ALL_ZERO pages map.
    * */
 
   if (not_present) {
@@ -188,6 +207,10 @@ page_fault (struct intr_frame *f)
 
     if (sup_page_table_has_entry (cur->spt, fault_page)) {
       // Lazy loading or Swapped
+      if (!write && sup_page_map_zero (fault_page)) {
+        // Reading a page never written
+        return;
+      }
       if (sup_page_load_page (fault_page)) {
         // Success
         return;
@@ -210,12 +233,17 @@ page_fault (struct intr_frame *f)
       }
     }
     // Fatal fault if not returned
+  } else if (write && is_user_vaddr (fault_addr)) {
+    // Copy on write
+    if (sup_page_write_fault (pg_round_down (fault_addr)))
+      return;
   }
 #endif
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+  /* A kernel access to user memory that has a fixup recovers
+     there instead of killing the process. */
+  if (!user && exception_fixup (f))
+    return;
 
   exit (-1);
 //  printf ("Page fault at %p: %s error %s page in %s context.\n",
@@ -226,3 +254,20 @@ page_fault (struct intr_frame *f)
 //  kill (f);
 }
 
+
+/* If F's faulting instruction has an exception table entry,
+   redirects F to resume at its fixup and returns true.
+   Otherwise returns false. */
+static bool
+exception_fixup (struct intr_frame *f)
+{
+  const struct exception_table_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void *) e->fixup;
+        return true;
+      }
+  return false;
+}
@@ -37,7 +37,10 @@ gdt_init (void)
 {
   uint64_t gdtr_operand;
 
-  /* Initialize GDT. */
+  /* Initialize GDT.  sysenter and sysexit derive the kernel data
+     and user code and data selectors from the kernel code
+     selector, as SEL_KCSEG + 8, + 16, and + 24, so these four must
+     stay in this order.  See tss_init(). */
   gdt[SEL_NULL / sizeof *gdt] = 0;
   gdt[SEL_KCSEG / sizeof *gdt] = make_code_desc (0);
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
@@ -0,0 +1,159 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Capacity of a pipe, in bytes. */
+#define PIPE_SIZE PGSIZE
+
+/* A pipe: a ring buffer shared by the processes holding its read
+   and write ends. */
+struct pipe
+  {
+    struct lock lock;           /* Protects the fields below. */
+    struct condition readable;  /* Data arrived or writers left. */
+    struct condition writable;  /* Space freed or readers left. */
+    uint8_t *buffer;            /* PIPE_SIZE bytes of data. */
+    size_t head;                /* Offset of the next byte to read. */
+    size_t used;                /* Number of bytes in BUFFER. */
+    int readers;                /* Number of open read ends. */
+    int writers;                /* Number of open write ends. */
+  };
+
+/* Creates an empty pipe with one read end and one write end
+   open.  Returns a null pointer if memory is short. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->buffer = palloc_get_page (0);
+  if (p->buffer == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->readable);
+  cond_init (&p->writable);
+  p->head = 0;
+  p->used = 0;
+  p->readers = 1;
+  p->writers = 1;
+  return p;
+}
+
+/* Opens another read end (or write end, if WRITE_END) of P. */
+void
+pipe_dup (struct pipe *p, bool write_end)
+{
+  lock_acquire (&p->lock);
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a read end (or write end, if WRITE_END) of P, waking
+   up whoever waits on the other side, and frees P once no end is
+   open. */
+void
+pipe_close (struct pipe *p, bool write_end)
+{
+  bool dead;
+
+  lock_acquire (&p->lock);
+  if (write_end)
+    {
+      ASSERT (p->writers > 0);
+      p->writers--;
+      cond_broadcast (&p->readable, &p->lock);
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      p->readers--;
+      cond_broadcast (&p->writable, &p->lock);
+    }
+  dead = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (dead)
+    {
+      palloc_free_page (p->buffer);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER, waiting until at
+   least one byte is available.  Returns the number of bytes
+   read, or 0 at end of file, that is, once P is empty and has no
+   write end left. */
+int
+pipe_read (struct pipe *p, void *buffer_, size_t size)
+{
+  uint8_t *buffer = buffer_;
+  size_t done = 0;
+
+  lock_acquire (&p->lock);
+  while (p->used == 0 && p->writers > 0 && size > 0)
+    cond_wait (&p->readable, &p->lock);
+  while (done < size && p->used > 0)
+    {
+      size_t chunk = PIPE_SIZE - p->head;
+      if (chunk > p->used)
+        chunk = p->used;
+      if (chunk > size - done)
+        chunk = size - done;
+      memcpy (buffer + done, p->buffer + p->head, chunk);
+      p->head = (p->head + chunk) % PIPE_SIZE;
+      p->used -= chunk;
+      done += chunk;
+    }
+  if (done > 0)
+    cond_broadcast (&p->writable, &p->lock);
+  lock_release (&p->lock);
+  return done;
+}
+
+/* Writes the SIZE bytes in BUFFER to P, waiting for space as
+   needed.  Returns SIZE, or the number of bytes written before
+   the last read end was closed, or -1 if none could be
+   written. */
+int
+pipe_write (struct pipe *p, const void *buffer_, size_t size)
+{
+  const uint8_t *buffer = buffer_;
+  size_t done = 0;
+
+  lock_acquire (&p->lock);
+  while (done < size)
+    {
+      size_t tail, chunk;
+
+      while (p->used == PIPE_SIZE && p->readers > 0)
+        cond_wait (&p->writable, &p->lock);
+      if (p->readers == 0)
+        break;
+
+      tail = (p->head + p->used) % PIPE_SIZE;
+      if (tail < p->head)
+        chunk = p->head - tail;
+      else
+        chunk = PIPE_SIZE - tail;
+      if (chunk > size - done)
+        chunk = size - done;
+      memcpy (p->buffer + tail, buffer + done, chunk);
+      p->used += chunk;
+      done += chunk;
+      cond_broadcast (&p->readable, &p->lock);
+    }
+  lock_release (&p->lock);
+  return done > 0 || size == 0 ? (int) done : -1;
+}
@@ -8,6 +8,9 @@
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "userprog/aio.h"
+#include "userprog/pipe.h"
+#include "userprog/syscall.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -35,6 +38,14 @@ static bool load (const char *args, void (**eip) (void), void **esp);
 static char *argv[LOADER_ARGS_LEN / 2 + 1];
 static int argc = 0;
 
+/* Passed from process_execute() to start_process().  Lives on the
+   parent's stack, which stays put until the child has loaded. */
+struct exec_args
+  {
+    char *args;                 /* Copy of the command line. */
+    struct thread *parent;      /* Thread calling process_execute(). */
+  };
+
 static void
 parse_args (char *s)
 {
@@ -53,6 +64,7 @@ tid_t
 process_execute (const char *args)
 {
   char *args_copy;
+  struct exec_args exec_args;
   tid_t tid;
   bool load_success;
   struct pcb *p;
@@ -69,7 +81,9 @@ process_execute (const char *args)
   parse_args (args_copy);
 
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (argv[0], PRI_DEFAULT, start_process, args_copy);
+  exec_args.args = args_copy;
+  exec_args.parent = thread_current ();
+  tid = thread_create (argv[0], PRI_DEFAULT, start_process, &exec_args);
   p = find_pcb (tid);
   pcb_set_parent (tid);
   sema_down (&p->process_loaded_sema);
@@ -85,15 +99,48 @@ process_execute (const char *args)
   return tid;
 }
 
+/* Gives the current thread its own copy of each pipe end that
+   PARENT has open, under the same descriptor.  Other open files
+   are not inherited. */
+static void
+inherit_pipes (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->fds); e != list_end (&parent->fds);
+       e = list_next (e))
+    {
+      struct file_descriptor *pfd
+        = list_entry (e, struct file_descriptor, elem);
+      struct file_descriptor *fd;
+
+      if (pfd->pipe == NULL)
+        continue;
+      fd = calloc (1, sizeof *fd);
+      if (fd == NULL)
+        break;
+      fd->fd = pfd->fd;
+      fd->pipe = pfd->pipe;
+      fd->write_end = pfd->write_end;
+      pipe_dup (fd->pipe, fd->write_end);
+      list_push_back (&t->fds, &fd->elem);
+    }
+  t->cur_fd = parent->cur_fd;
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *args_)
+start_process (void *exec_args_)
 {
-  char *args = args_;
+  struct exec_args *exec_args = exec_args_;
+  char *args = exec_args->args;
   struct intr_frame if_;
   bool success;
 
+  inherit_pipes (exec_args->parent);
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -116,6 +163,129 @@ start_process (void *args_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Passed from process_fork() to start_fork().  Lives on the
+   parent's stack, which stays put until the child has copied
+   what it needs. */
+struct fork_args
+  {
+    struct thread *parent;      /* Thread calling process_fork(). */
+    struct intr_frame *if_;     /* Its system call frame. */
+  };
+
+static thread_func start_fork NO_RETURN;
+
+/* Creates a child process that is a copy of the current one, and
+   resumes it from the system call frame F with 0 as the return
+   value.  The child shares the parent's pages copy-on-write and
+   has its own handle on each of the parent's open files.
+   Returns the child's thread id, or TID_ERROR if it cannot be
+   created. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct fork_args fork_args;
+  tid_t tid;
+  struct pcb *p;
+
+  fork_args.parent = thread_current ();
+  fork_args.if_ = f;
+  tid = thread_create (fork_args.parent->name, PRI_DEFAULT, start_fork,
+                       &fork_args);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  p = find_pcb (tid);
+  pcb_set_parent (tid);
+  sema_down (&p->process_loaded_sema);
+  return pcb_loaded (tid) ? tid : TID_ERROR;
+}
+
+/* Gives the current thread its own handle on PARENT's executable
+   and on each file PARENT has open, under the same descriptor
+   and at the same position.  Returns false if memory is short. */
+static bool
+inherit_files (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  if (parent->executable != NULL)
+    {
+      t->executable = file_reopen (parent->executable);
+      if (t->executable == NULL)
+        return false;
+      file_deny_write (t->executable);
+    }
+
+  for (e = list_begin (&parent->fds); e != list_end (&parent->fds);
+       e = list_next (e))
+    {
+      struct file_descriptor *pfd
+        = list_entry (e, struct file_descriptor, elem);
+      struct file_descriptor *fd = calloc (1, sizeof *fd);
+
+      if (fd == NULL)
+        return false;
+      fd->fd = pfd->fd;
+      if (pfd->pipe != NULL)
+        {
+          fd->pipe = pfd->pipe;
+          fd->write_end = pfd->write_end;
+          pipe_dup (fd->pipe, fd->write_end);
+        }
+      else
+        {
+          fd->file = file_reopen (pfd->file);
+          if (fd->file == NULL)
+            {
+              free (fd);
+              return false;
+            }
+          file_seek (fd->file, file_tell (pfd->file));
+          if (pfd->dir != NULL)
+            fd->dir = dir_reopen (pfd->dir);
+        }
+      list_push_back (&t->fds, &fd->elem);
+    }
+  t->cur_fd = parent->cur_fd;
+  return true;
+}
+
+/* A thread function that copies the parent process described by
+   FORK_ARGS_ and resumes the copy in user mode. */
+static void
+start_fork (void *fork_args_)
+{
+  struct fork_args *fork_args = fork_args_;
+  struct thread *parent = fork_args->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = *fork_args->if_;
+  bool success = false;
+
+  t->pagedir = pagedir_create ();
+  t->spt = sup_page_create ();
+  if (t->pagedir != NULL)
+    {
+      process_activate ();
+      sema_down_filesys ();
+      success = inherit_files (parent);
+      sema_up_filesys ();
+      success = success && sup_page_fork (parent);
+    }
+
+  if (success)
+    pcb_update_loaded ();
+  pcb_p_loaded_sema_up ();
+  if (!success)
+    thread_exit ();
+
+  /* Return 0 from fork() in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -152,13 +322,10 @@ process_exit (void)
   struct hash *spt;
 
   struct file *file = cur->executable;
-  if (file != NULL) {
-    file_close (file);
-  }
+
+  aio_exit ();
 
   printf("%s: exit(%d)\n", cur->name, cur->exit_status);
-  pcb_update_status (cur->exit_status);
-  pcb_wait_sema_up ();
 
 #ifdef VM
   free_mmap_all();
@@ -167,8 +334,17 @@ process_exit (void)
   {
     sup_page_destroy (spt);
   }
+  sup_page_destroy_ranges ();
 #endif
 
+  /* Allow writes to the executable only once its pages have left
+     the page cache, but before the parent returns from wait(). */
+  if (file != NULL) {
+    file_close (file);
+  }
+  pcb_update_status (cur->exit_status);
+  pcb_wait_sema_up ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -463,6 +639,15 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  /* A read-only segment is reserved as a whole and its pages are
+     loaded on first access, from the page cache if another
+     process running this executable has them. */
+  if (!writable)
+    return sup_page_reserve_range (upage, read_bytes + zero_bytes, file,
+                                   ofs, read_bytes, false);
+#endif
+
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -472,6 +657,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* The pages of zeros at the end of a writable segment, such
+         as the BSS, are reserved as a whole and get no frame
+         until they are written. */
+      if (page_read_bytes == 0)
+        return sup_page_reserve_range (upage, zero_bytes, NULL, 0, 0, true);
+#endif
+
       /* Get a page of memory. */
       uint8_t *kpage = allocate_frame_and_pin (PAL_USER, upage, true);
       if (kpage == NULL)
@@ -572,7 +765,7 @@ install_page (void *upage, void *kpage, bool writable)
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 
 #ifdef VM
-  success = success && (sup_page_install_frame (t->spt, upage, kpage));
+  success = success && (sup_page_install_frame (t->spt, upage, kpage, writable));
 #endif
   return success;
 }
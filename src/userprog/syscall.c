@@ -1,17 +1,24 @@
 #include "userprog/syscall.h"
+#include <console.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include <iovec.h>
 #include <devices/shutdown.h>
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "filesys/inode.h"
+#include "filesys/cache.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "pagedir.h"
 #include "process.h"
+#include "userprog/aio.h"
+#include "userprog/pipe.h"
+#include "userprog/uaccess.h"
 
 #include "vm/page.h"
 
@@ -28,12 +35,20 @@ static int write (int fd, const void *buffer, unsigned size);
 static void seek (int fd, unsigned position);
 static unsigned tell (int fd);
 static void close (int fd);
+static int readv (int fd, const struct iovec *iov, int iovcnt);
+static int writev (int fd, const struct iovec *iov, int iovcnt);
+static int pread (int fd, void *buffer, unsigned length, unsigned offset);
+static int pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+static int copy_file_range (int fd_in, int fd_out, unsigned length);
+static int fsync (int fd);
+static void sync (void);
+static int pipe (int *ufds);
+static int dmesg (char *buffer, unsigned size);
 #ifdef VM
 static mapid_t mmap (int fd, void* upage);
 static void munmap(mapid_t mapid);
-static void check_pd (const void *uaddr);
-void load_and_pin_buffer (const void *buffer, unsigned length);
-void unpin_buffer (const void *buffer, unsigned length);
+static int fork (void);
+static int msync (mapid_t mapid);
 #endif
 #ifdef FILESYS
 static bool chdir (const char *path);
@@ -56,179 +71,360 @@ void sema_down_filesys ()
   sema_down (&filesys_sema);
 }
 
+bool sema_try_down_filesys ()
+{
+  return sema_try_down (&filesys_sema);
+}
+
 void
 syscall_init (void) 
 {
   sema_init (&filesys_sema, 1);
+  aio_init ();
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
+/* Copies SIZE bytes from user address USRC to KDST, killing
+   the process if USRC is bad. */
 static void
-is_valid_uaddr (void *uaddr)
+fetch_user (void *kdst, const void *usrc, size_t size)
 {
-  if (uaddr == NULL || !is_user_vaddr(uaddr))
-  {
-    exit(-1);
-  }
-#ifndef VM
-  /* Check given pointer is mapped or unmapped */
-  uint32_t *pd = thread_current()->pagedir;
-  if (pagedir_get_page (pd, uaddr) == NULL)
-  {
+  if (!copy_from_user (kdst, usrc, size))
     exit (-1);
-  }
-#endif
 }
 
+/* Copies SIZE bytes from KSRC to user address UDST, killing the
+   process if UDST is bad. */
 static void
-is_valid_arg (void *arg, size_t size)
+store_user (void *udst, const void *ksrc, size_t size)
 {
-  if (arg == NULL)
-  {
+  if (!copy_to_user (udst, ksrc, size))
     exit (-1);
-  }
-  void* uaddr = (void *) *(uint32_t *) arg;
-  is_valid_uaddr (uaddr);
-  is_valid_uaddr (uaddr + size);
 }
 
-static void
-read_argument (void **esp, void **args, uint8_t num)
+/* Copies the string at user address USTR into a new page, which
+   the caller must free.  Kills the process if USTR is bad or
+   longer than a page. */
+static char *
+fetch_user_string (const char *ustr)
 {
-  int i;
-  void *tmp = *esp +4;
+  char *kstr = palloc_get_page (0);
 
-  for (i = 0; i < num; i++) {
-    args[i] = tmp;
-    tmp += 4;
-  }
-  is_valid_uaddr (tmp);
+  if (kstr == NULL)
+    exit (-1);
+  if (strncpy_from_user (kstr, ustr, PGSIZE) < 0)
+    {
+      palloc_free_page (kstr);
+      exit (-1);
+    }
+  return kstr;
 }
 
-static void
-syscall_handler(struct intr_frame *f) {
-  void *args[3];
-  int syscall_number;
-  is_valid_uaddr (f->esp);
-  is_valid_uaddr (f->esp + sizeof (int));
-  syscall_number = *(int *) (f->esp);
-//  printf("Syscall nunmber %d\n", syscall_number);
-  thread_current ()->esp = f->esp;
+/* How a system call argument is passed to the call.  Buffers
+   are accessed by the call itself through copy_from_user() and
+   copy_to_user(). */
+enum arg_kind
+  {
+    ARG_VAL,                    /* Passed as is. */
+    ARG_STR                     /* String, copied into the kernel. */
+  };
+
+/* A system call: its implementation and its arguments. */
+struct syscall_desc
+  {
+    uint32_t (*func) (const uint32_t *argv);
+    uint8_t argc;               /* Number of argument words. */
+    uint8_t kinds[4];           /* One enum arg_kind per argument. */
+  };
+
+static uint32_t
+sys_halt (const uint32_t *argv UNUSED)
+{
+  halt ();
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_exit (const uint32_t *argv)
+{
+  exit (argv[0]);
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_exec (const uint32_t *argv)
+{
+  return exec ((const char *) argv[0]);
+}
+
+static uint32_t
+sys_wait (const uint32_t *argv)
+{
+  return wait (argv[0]);
+}
+
+static uint32_t
+sys_create (const uint32_t *argv)
+{
+  return create ((const char *) argv[0], argv[1]);
+}
+
+static uint32_t
+sys_remove (const uint32_t *argv)
+{
+  return remove ((const char *) argv[0]);
+}
+
+static uint32_t
+sys_open (const uint32_t *argv)
+{
+  return open ((const char *) argv[0]);
+}
+
+static uint32_t
+sys_filesize (const uint32_t *argv)
+{
+  return filesize (argv[0]);
+}
+
+static uint32_t
+sys_read (const uint32_t *argv)
+{
+  return read (argv[0], (void *) argv[1], argv[2]);
+}
+
+static uint32_t
+sys_write (const uint32_t *argv)
+{
+  return write (argv[0], (const void *) argv[1], argv[2]);
+}
+
+static uint32_t
+sys_seek (const uint32_t *argv)
+{
+  seek (argv[0], argv[1]);
+  return 0;
+}
+
+static uint32_t
+sys_tell (const uint32_t *argv)
+{
+  return tell (argv[0]);
+}
+
+static uint32_t
+sys_close (const uint32_t *argv)
+{
+  close (argv[0]);
+  return 0;
+}
 
-  switch (syscall_number) {
-    case SYS_HALT:
-//      printf ("syscall HALT called\n");
-        halt ();
-      break;
-    case SYS_EXIT:
-      read_argument (&(f->esp), args, 1);
-      f->eax = *(int *) args[0];
-      exit (*(int *) args[0]);
-      break;
-    case SYS_EXEC:
-//      printf ("syscall EXEC called\n");
-      read_argument (&(f->esp), args, 1);
-      is_valid_arg(args[0], sizeof (char *));
-      f->eax = exec ((char *) *(uint32_t *) args[0]);
-      break;
-    case SYS_WAIT:
-//      printf ("syscall WAIT called\n");
-      read_argument (&(f->esp), args, 1);
-      is_valid_uaddr (args[0] + 4);
-      f->eax = wait (*(int *) args[0]);
-      break;
-    case SYS_CREATE:
-//      printf ("syscall CREATE called\n");
-      read_argument (&(f->esp), args, 2);
-      is_valid_arg(args[0], sizeof (char *));
-      f->eax = create ( (char *) *(uint32_t *) args[0], *(unsigned *) args[1]);
-      break;
-    case SYS_REMOVE:
-//      printf ("syscall REMOVE called\n");
-      read_argument (&(f->esp), args, 1);
-      is_valid_arg(args[0], sizeof (char *));
-      f->eax = remove ((char *) *(uint32_t *) args[0]);
-      break;
-    case SYS_OPEN:
-      read_argument (&(f->esp), args, 1);
-      is_valid_arg(args[0], sizeof (char *));
-      f->eax = open ((char *) *(uint32_t *) args[0]);
-      break;
-    case SYS_FILESIZE:
-      read_argument (&(f->esp), args, 1);
-      f->eax = filesize(*(int *)args[0]);
-//      printf ("syscall FILESIZE called\n");
-      break;
-    case SYS_READ:
-//      printf ("syscall READ called\n");
-      read_argument (&(f->esp), args, 3);
-      is_valid_arg(args[1], sizeof (void *));
-      f->eax = read (*(int *) args[0], (void *) *(uint32_t *) args[1], *(unsigned *) args[2]);
-      break;
-    case SYS_WRITE:
-      read_argument (&(f->esp), args, 3);
-      is_valid_arg(args[1], sizeof (void *));
-      f->eax = write (*(int *) args[0], (void *) *(uint32_t *) args[1], *(unsigned *) args[2]);
-      break;
-    case SYS_SEEK:
-//      printf ("syscall SEEK called\n");
-      read_argument (&(f->esp), args, 2);
-      seek (*(int *) args[0], *(unsigned *) args[1]);
-      break;
-    case SYS_TELL:
-//      printf ("syscall TELL called\n");
-      read_argument (&(f->esp), args, 1);
-      f->eax = tell (*(int *) args[0]);
-      break;
-    case SYS_CLOSE:
-//      printf ("syscall CLOSE called\n");
-      read_argument (&(f->esp), args, 1);
-      close (*(int *) args[0]);
-      break;
 #ifdef VM
-      /* Project 3 and optionally project 4. */
-    case SYS_MMAP:
-//      printf ("syscall MMAP called\n");
-      read_argument (&(f->esp), args, 2);
-      //is_valid_arg(args[1], sizeof (void *)); why???
-      f->eax = mmap (*(int*)args[0], (void*) *(uint32_t *) args[1]);
-      break;
-    case SYS_MUNMAP:
-      read_argument (&(f->esp), args, 1);
-      munmap(*(mapid_t*) args[0]);
-      break;
+static uint32_t
+sys_mmap (const uint32_t *argv)
+{
+  return mmap (argv[0], (void *) argv[1]);
+}
+
+static uint32_t
+sys_munmap (const uint32_t *argv)
+{
+  munmap (argv[0]);
+  return 0;
+}
+
+static uint32_t
+sys_fork (const uint32_t *argv UNUSED)
+{
+  return fork ();
+}
+
+static uint32_t
+sys_msync (const uint32_t *argv)
+{
+  return msync (argv[0]);
+}
 #endif
 
 #ifdef FILESYS
-      /* Project 4 only. */
-    case SYS_CHDIR:
-      read_argument (&(f->esp), args, 1);
-      is_valid_arg(args[0], sizeof (void *));
-      f->eax = chdir (*(char **) args[0]);
-      break;
-    case SYS_MKDIR:
-      read_argument (&(f->esp), args, 1);
-      is_valid_arg(args[0], sizeof (void *));
-      f->eax = mkdir (*(char **) args[0]);
-      break;
-    case SYS_READDIR:
-      read_argument (&(f->esp), args, 2);
-      is_valid_arg(args[1], sizeof (void *));
-      f->eax = readdir (*(int *) args[0], *(char **) args[1]);
-      break;
-    case SYS_ISDIR:
-      read_argument (&(f->esp), args, 1);
-      f->eax = isdir (*(int *) args[0]);
-      break;
-    case SYS_INUMBER:
-      read_argument (&(f->esp), args, 1);
-      f->eax = inumber (*(int *) args[0]);
-      break;
+static uint32_t
+sys_chdir (const uint32_t *argv)
+{
+  return chdir ((const char *) argv[0]);
+}
+
+static uint32_t
+sys_mkdir (const uint32_t *argv)
+{
+  return mkdir ((const char *) argv[0]);
+}
+
+static uint32_t
+sys_readdir (const uint32_t *argv)
+{
+  return readdir (argv[0], (char *) argv[1]);
+}
+
+static uint32_t
+sys_isdir (const uint32_t *argv)
+{
+  return isdir (argv[0]);
+}
+
+static uint32_t
+sys_inumber (const uint32_t *argv)
+{
+  return inumber (argv[0]);
+}
 #endif
-    default:
-//      printf("syscall default called\n");
-      break;
-  }
+
+static uint32_t
+sys_readv (const uint32_t *argv)
+{
+  return readv (argv[0], (const struct iovec *) argv[1], argv[2]);
+}
+
+static uint32_t
+sys_writev (const uint32_t *argv)
+{
+  return writev (argv[0], (const struct iovec *) argv[1], argv[2]);
+}
+
+static uint32_t
+sys_pread (const uint32_t *argv)
+{
+  return pread (argv[0], (void *) argv[1], argv[2], argv[3]);
+}
+
+static uint32_t
+sys_pwrite (const uint32_t *argv)
+{
+  return pwrite (argv[0], (const void *) argv[1], argv[2], argv[3]);
+}
+
+static uint32_t
+sys_copy_file_range (const uint32_t *argv)
+{
+  return copy_file_range (argv[0], argv[1], argv[2]);
+}
+
+static uint32_t
+sys_fsync (const uint32_t *argv)
+{
+  return fsync (argv[0]);
+}
+
+static uint32_t
+sys_sync (const uint32_t *argv UNUSED)
+{
+  sync ();
+  return 0;
+}
+
+static uint32_t
+sys_aio_setup (const uint32_t *argv)
+{
+  return aio_setup ((void *) argv[0]);
+}
+
+static uint32_t
+sys_aio_enter (const uint32_t *argv)
+{
+  return aio_enter (argv[0], argv[1]);
+}
+
+static uint32_t
+sys_pipe (const uint32_t *argv)
+{
+  return pipe ((int *) argv[0]);
+}
+
+static uint32_t
+sys_dmesg (const uint32_t *argv)
+{
+  return dmesg ((char *) argv[0], argv[1]);
+}
+
+/* System call table, indexed by system call number. */
+static const struct syscall_desc syscall_table[] =
+  {
+    [SYS_HALT] = {sys_halt, 0, {}},
+    [SYS_EXIT] = {sys_exit, 1, {ARG_VAL}},
+    [SYS_EXEC] = {sys_exec, 1, {ARG_STR}},
+    [SYS_WAIT] = {sys_wait, 1, {ARG_VAL}},
+    [SYS_CREATE] = {sys_create, 2, {ARG_STR, ARG_VAL}},
+    [SYS_REMOVE] = {sys_remove, 1, {ARG_STR}},
+    [SYS_OPEN] = {sys_open, 1, {ARG_STR}},
+    [SYS_FILESIZE] = {sys_filesize, 1, {ARG_VAL}},
+    [SYS_READ] = {sys_read, 3, {ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_WRITE] = {sys_write, 3, {ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_SEEK] = {sys_seek, 2, {ARG_VAL, ARG_VAL}},
+    [SYS_TELL] = {sys_tell, 1, {ARG_VAL}},
+    [SYS_CLOSE] = {sys_close, 1, {ARG_VAL}},
+#ifdef VM
+    /* Project 3 and optionally project 4. */
+    [SYS_MMAP] = {sys_mmap, 2, {ARG_VAL, ARG_VAL}},
+    [SYS_MUNMAP] = {sys_munmap, 1, {ARG_VAL}},
+#endif
+#ifdef FILESYS
+    /* Project 4 only. */
+    [SYS_CHDIR] = {sys_chdir, 1, {ARG_STR}},
+    [SYS_MKDIR] = {sys_mkdir, 1, {ARG_STR}},
+    [SYS_READDIR] = {sys_readdir, 2, {ARG_VAL, ARG_VAL}},
+    [SYS_ISDIR] = {sys_isdir, 1, {ARG_VAL}},
+    [SYS_INUMBER] = {sys_inumber, 1, {ARG_VAL}},
+#endif
+    /* Extensions. */
+    [SYS_READV] = {sys_readv, 3, {ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_WRITEV] = {sys_writev, 3, {ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_PREAD] = {sys_pread, 4, {ARG_VAL, ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_PWRITE] = {sys_pwrite, 4, {ARG_VAL, ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_COPY_FILE_RANGE] = {sys_copy_file_range, 3,
+                             {ARG_VAL, ARG_VAL, ARG_VAL}},
+    [SYS_FSYNC] = {sys_fsync, 1, {ARG_VAL}},
+    [SYS_SYNC] = {sys_sync, 0, {}},
+    [SYS_AIO_SETUP] = {sys_aio_setup, 1, {ARG_VAL}},
+    [SYS_AIO_ENTER] = {sys_aio_enter, 2, {ARG_VAL, ARG_VAL}},
+    [SYS_PIPE] = {sys_pipe, 1, {ARG_VAL}},
+    [SYS_DMESG] = {sys_dmesg, 2, {ARG_VAL, ARG_VAL}},
+#ifdef VM
+    [SYS_FORK] = {sys_fork, 0, {}},
+    [SYS_MSYNC] = {sys_msync, 1, {ARG_VAL}},
+#endif
+  };
+
+/* Looks up the system call whose number is on the user stack,
+   copies in its arguments and any string argument, and makes
+   the call.  No system call takes more than one string. */
+static void
+syscall_handler (struct intr_frame *f)
+{
+  const struct syscall_desc *desc;
+  uint32_t argv[4];
+  uint32_t syscall_number;
+  char *kstr = NULL;
+  int i;
+
+  fetch_user (&syscall_number, f->esp, sizeof syscall_number);
+  thread_current ()->esp = f->esp;
+  thread_current ()->syscall_frame = f;
+
+  if (syscall_number >= sizeof syscall_table / sizeof *syscall_table
+      || syscall_table[syscall_number].func == NULL)
+    return;
+  desc = &syscall_table[syscall_number];
+
+  fetch_user (argv, (uint32_t *) f->esp + 1, desc->argc * sizeof *argv);
+  for (i = 0; i < desc->argc; i++)
+    if (desc->kinds[i] == ARG_STR)
+      {
+        ASSERT (kstr == NULL);
+        kstr = fetch_user_string ((const char *) argv[i]);
+        argv[i] = (uint32_t) kstr;
+      }
+
+  f->eax = desc->func (argv);
+  palloc_free_page (kstr);
 }
 
 static void
@@ -276,34 +472,199 @@ static bool create
   return result;
 }
 
+/* Writes SIZE bytes from user BUFFER to the console, a page
+   at a time.  Kills the process if BUFFER is bad. */
 static int
-write (int fd, const void *buffer, unsigned size)
+console_write (const void *buffer, unsigned size)
 {
-  if (fd == 1) {
-    putbuf (buffer, size);
-    return size;
-  } else {
-    int result = -1;
-    struct file *file;
+  char *kbuf = palloc_get_page (0);
+  unsigned done = 0;
 
-    sema_down (&filesys_sema);
-    file = find_file (fd);
-    struct inode * inode = file_get_inode (file);
-    bool is_dir = inode_is_dir (inode);
-    if (file != NULL && !is_dir){
-#ifdef VM
-      check_pd (buffer);
-      load_and_pin_buffer (buffer, size);
-#endif
-      result = file_write (file, buffer, size);
-#ifdef VM
-      unpin_buffer (buffer, size);
-#endif
+  if (kbuf == NULL)
+    return -1;
+  while (done < size)
+    {
+      unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+      if (!copy_from_user (kbuf, buffer + done, chunk))
+        {
+          palloc_free_page (kbuf);
+          exit (-1);
+        }
+      putbuf (kbuf, chunk);
+      done += chunk;
     }
-    sema_up (&filesys_sema);
+  palloc_free_page (kbuf);
+  return size;
+}
+
+/* Reads (if WRITING is false) or writes (if WRITING is true)
+   SIZE bytes between user BUFFER and FILE, at byte OFFSET or, if
+   OFFSET is negative, at FILE's current position, a page at a
+   time through KBUF, a kernel page.  The caller must hold
+   filesys_sema.  Faults on BUFFER are taken with it held, which
+   is safe: loading a user page never needs it, and eviction only
+   tries it.  The data cannot go straight between the buffer cache
+   and BUFFER, because a fault there would hold the cache's lock,
+   which loading a file page needs.  Sets *FAULT if BUFFER is bad.
+   Returns the number of bytes transferred. */
+static int
+file_transfer_locked (struct file *file, uint8_t *kbuf, void *buffer,
+                      unsigned size, off_t offset, bool writing,
+                      bool *fault)
+{
+  int result = 0;
+
+  while (size > 0)
+  {
+    off_t chunk = size < PGSIZE ? size : PGSIZE;
+    off_t bytes;
+
+    if (writing && !copy_from_user (kbuf, buffer + result, chunk))
+    {
+      *fault = true;
+      break;
+    }
+    if (offset >= 0)
+      bytes = writing
+              ? file_write_at (file, kbuf, chunk, offset + result)
+              : file_read_at (file, kbuf, chunk, offset + result);
+    else
+      bytes = writing
+              ? file_write (file, kbuf, chunk)
+              : file_read (file, kbuf, chunk);
+    if (!writing && !copy_to_user (buffer + result, kbuf, bytes))
+    {
+      *fault = true;
+      break;
+    }
+
+    result += bytes;
+    size -= bytes;
+    if (bytes != chunk)
+      break;
+  }
+  return result;
+}
+
+/* Reads or writes SIZE bytes between user BUFFER and FILE, as
+   file_transfer_locked(), under one acquisition of filesys_sema
+   so that other file system calls do not interleave with it.
+   Kills the process if BUFFER is bad.  Returns the number of
+   bytes transferred, or -1. */
+static int
+file_transfer (struct file *file, void *buffer, unsigned size, off_t offset,
+               bool writing)
+{
+  uint8_t *kbuf = palloc_get_page (0);
+  bool fault = false;
+  int result;
+
+  if (kbuf == NULL)
+    return -1;
+  sema_down (&filesys_sema);
+  result = file_transfer_locked (file, kbuf, buffer, size, offset, writing,
+                                 &fault);
+  sema_up (&filesys_sema);
+  palloc_free_page (kbuf);
+  if (fault)
+    exit (-1);
+  return result;
+}
+
+/* Returns the regular file open as FD, or a null pointer if FD
+   is not open or names a directory. */
+static struct file *
+find_regular_file (int fd)
+{
+  struct file *file;
 
-    return result;
+  sema_down (&filesys_sema);
+  file = find_file (fd);
+  if (file != NULL && inode_is_dir (file_get_inode (file)))
+    file = NULL;
+  sema_up (&filesys_sema);
+  return file;
+}
+
+/* Returns the pipe whose write end (if WRITE_END) or read end
+   is open as FD, or a null pointer if FD is not such an end. */
+static struct pipe *
+find_pipe (int fd, bool write_end)
+{
+  struct file_descriptor *fd_info = find_fd (fd);
+
+  if (fd_info == NULL || fd_info->pipe == NULL
+      || fd_info->write_end != write_end)
+    return NULL;
+  return fd_info->pipe;
+}
+
+/* Reads into (if WRITING is false) or writes from (if WRITING
+   is true) user BUFFER through PIPE, a page at a time.  A read
+   returns as soon as any data has arrived; a write waits until
+   all SIZE bytes fit.  Kills the process if BUFFER is bad.
+   Returns the number of bytes transferred, or -1. */
+static int
+pipe_transfer (struct pipe *pipe, void *buffer, unsigned size, bool writing)
+{
+  uint8_t *kbuf = palloc_get_page (0);
+  int result = 0;
+
+  if (kbuf == NULL)
+    return -1;
+  while (size > 0)
+  {
+    int chunk = size < PGSIZE ? size : PGSIZE;
+    int bytes;
+
+    if (writing)
+    {
+      if (!copy_from_user (kbuf, buffer + result, chunk))
+        goto fault;
+      bytes = pipe_write (pipe, kbuf, chunk);
+      if (bytes < 0)
+      {
+        if (result == 0)
+          result = -1;
+        break;
+      }
+    }
+    else
+    {
+      bytes = pipe_read (pipe, kbuf, chunk);
+      if (!copy_to_user (buffer + result, kbuf, bytes))
+        goto fault;
+    }
+
+    result += bytes;
+    size -= bytes;
+    if (!writing || bytes != chunk)
+      break;
   }
+  palloc_free_page (kbuf);
+  return result;
+
+ fault:
+  palloc_free_page (kbuf);
+  exit (-1);
+  NOT_REACHED ();
+}
+
+static int
+write (int fd, const void *buffer, unsigned size)
+{
+  struct file *file;
+  struct pipe *pipe;
+
+  if (fd == 1)
+    return console_write (buffer, size);
+  pipe = find_pipe (fd, true);
+  if (pipe != NULL)
+    return pipe_transfer (pipe, (void *) buffer, size, true);
+  file = find_regular_file (fd);
+  if (file == NULL)
+    return -1;
+  return file_transfer (file, (void *) buffer, size, -1, true);
 }
 
 static bool
@@ -356,32 +717,15 @@ open (const char *file_name)
 static int
 read (int fd, void *buffer, unsigned length)
 {
-  int result = -1;
+  struct pipe *pipe = find_pipe (fd, false);
   struct file *file;
-  char tmp;
-  file = find_file(fd);
-  struct inode * inode = file_get_inode (file);
-  bool is_dir = inode_is_dir (inode);
-  sema_down (&filesys_sema);
-  if (file != NULL && !is_dir){
-#ifdef VM
-    tmp = *(char *)buffer;
-    if (tmp)
-    {
-      load_and_pin_buffer (buffer, length);
-    }
-    else {
-      load_and_pin_buffer (buffer, length);
-    }
-#endif
-    result = file_read (file, buffer, length);
-#ifdef VM
-    unpin_buffer (buffer, length);
-#endif
-  }
 
-  sema_up (&filesys_sema);
-  return result;
+  if (pipe != NULL)
+    return pipe_transfer (pipe, buffer, length, false);
+  file = find_regular_file (fd);
+  if (file == NULL)
+    return -1;
+  return file_transfer (file, buffer, length, -1, false);
 }
 
 static void
@@ -417,7 +761,8 @@ tell (int fd)
   int result;
   sema_down (&filesys_sema);
   struct file_descriptor *fd_info = find_fd (fd);
-  result = file_tell(fd_info->file);
+  result = fd_info != NULL && fd_info->file != NULL
+           ? file_tell (fd_info->file) : -1;
   sema_up (&filesys_sema);
   return result; 
 }
@@ -432,11 +777,262 @@ close (int fd)
     if (fd_info->dir) {
       dir_close (fd_info->dir);
     }
-    file_close (fd_info->file);
+    if (fd_info->pipe != NULL)
+      pipe_close (fd_info->pipe, fd_info->write_end);
+    else
+      file_close (fd_info->file);
     free (fd_info);
   }
   sema_up (&filesys_sema);
 }
+
+/* Adds a file descriptor for an end of PIPE to the current
+   process.  Returns the new descriptor, or -1 if memory is
+   short. */
+static int
+add_pipe_fd (struct pipe *pipe, bool write_end)
+{
+  struct thread *t = thread_current ();
+  struct file_descriptor *fd_info = calloc (1, sizeof *fd_info);
+
+  if (fd_info == NULL)
+    return -1;
+  fd_info->pipe = pipe;
+  fd_info->write_end = write_end;
+  fd_info->fd = ++(t->cur_fd);
+  list_push_back (&t->fds, &fd_info->elem);
+  return fd_info->fd;
+}
+
+/* Creates a pipe and stores the descriptors of its read and
+   write ends in UFDS[0] and UFDS[1].  Returns 0 if successful,
+   -1 otherwise. */
+static int
+pipe (int *ufds)
+{
+  struct pipe *p = pipe_create ();
+  int fds[2];
+
+  if (p == NULL)
+    return -1;
+  fds[0] = add_pipe_fd (p, false);
+  if (fds[0] < 0)
+  {
+    pipe_close (p, false);
+    pipe_close (p, true);
+    return -1;
+  }
+  fds[1] = add_pipe_fd (p, true);
+  if (fds[1] < 0)
+  {
+    close (fds[0]);
+    pipe_close (p, true);
+    return -1;
+  }
+  store_user (ufds, fds, sizeof fds);
+  return 0;
+}
+
+/* Copies the IOVCNT buffer descriptors at UIOV into a newly
+   allocated kernel array.  Kills the process if UIOV is a bad
+   user pointer.  The buffers themselves are checked as they are
+   used.  Returns a null pointer if IOVCNT is out of range or
+   memory allocation fails. */
+static struct iovec *
+copy_in_iovec (const struct iovec *uiov, int iovcnt)
+{
+  struct iovec *iov;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return NULL;
+
+  iov = malloc (iovcnt * sizeof *iov);
+  if (iov != NULL && !copy_from_user (iov, uiov, iovcnt * sizeof *iov))
+  {
+    free (iov);
+    exit (-1);
+  }
+  return iov;
+}
+
+/* Reads into (if WRITING is false) or writes from (if WRITING
+   is true) the IOVCNT buffers at UIOV, in order, using FD's
+   current position, under one acquisition of filesys_sema.
+   Stops at the first short transfer.  Kills the process if a
+   buffer is bad.  Returns the total number of bytes transferred,
+   or -1. */
+static int
+iovec_transfer (int fd, const struct iovec *uiov, int iovcnt, bool writing)
+{
+  struct iovec *iov;
+  struct file *file = NULL;
+  uint8_t *kbuf = NULL;
+  bool fault = false;
+  int result = 0;
+  int i;
+
+  if (iovcnt == 0)
+    return 0;
+  if (!(fd == 1 && writing))
+  {
+    file = find_regular_file (fd);
+    if (file == NULL)
+      return -1;
+  }
+  iov = copy_in_iovec (uiov, iovcnt);
+  if (iov == NULL)
+    return -1;
+  if (file != NULL)
+  {
+    kbuf = palloc_get_page (0);
+    if (kbuf == NULL)
+    {
+      free (iov);
+      return -1;
+    }
+    sema_down (&filesys_sema);
+  }
+
+  for (i = 0; i < iovcnt && !fault; i++)
+  {
+    int bytes = file == NULL
+                ? console_write (iov[i].iov_base, iov[i].iov_len)
+                : file_transfer_locked (file, kbuf, iov[i].iov_base,
+                                        iov[i].iov_len, -1, writing,
+                                        &fault);
+    if (bytes < 0)
+    {
+      if (result == 0)
+        result = -1;
+      break;
+    }
+    result += bytes;
+    if (bytes != (int) iov[i].iov_len)
+      break;
+  }
+
+  if (file != NULL)
+  {
+    sema_up (&filesys_sema);
+    palloc_free_page (kbuf);
+  }
+  free (iov);
+  if (fault)
+    exit (-1);
+  return result;
+}
+
+static int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return iovec_transfer (fd, iov, iovcnt, false);
+}
+
+static int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return iovec_transfer (fd, iov, iovcnt, true);
+}
+
+/* Reads (if WRITING is false) or writes (if WRITING is true)
+   LENGTH bytes between BUFFER and FD at byte OFFSET, without
+   touching FD's current position, so that threads sharing FD
+   do not race on it.  Returns the number of bytes transferred,
+   or -1 if FD does not name a regular file. */
+static int
+positional_transfer (int fd, void *buffer, unsigned length, unsigned offset,
+                     bool writing)
+{
+  struct file *file;
+
+  if ((off_t) offset < 0)
+    return -1;
+  file = find_regular_file (fd);
+  if (file == NULL)
+    return -1;
+  return file_transfer (file, buffer, length, offset, writing);
+}
+
+static int
+pread (int fd, void *buffer, unsigned length, unsigned offset)
+{
+  return positional_transfer (fd, buffer, length, offset, false);
+}
+
+static int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return positional_transfer (fd, (void *) buffer, size, offset, true);
+}
+
+/* Copies LENGTH bytes from FD_IN to FD_OUT, starting at and
+   advancing each file's current position, without bouncing the
+   data through user memory.  Returns the number of bytes copied,
+   or -1 if either fd does not name a regular file or, as on
+   Linux, if the ranges copied from and to overlap in the same
+   file, in which case the copy would read its own output.
+   Copying nothing succeeds, even from a file onto itself. */
+static int
+copy_file_range (int fd_in, int fd_out, unsigned length)
+{
+  struct file *in, *out;
+  int result = -1;
+
+  if ((off_t) length < 0)
+    return -1;
+
+  sema_down (&filesys_sema);
+  in = find_file (fd_in);
+  out = find_file (fd_out);
+  if (in != NULL && out != NULL
+      && !inode_is_dir (file_get_inode (in))
+      && !inode_is_dir (file_get_inode (out)))
+    {
+      if (length == 0)
+        result = 0;
+      else if (!(file_get_inode (in) == file_get_inode (out)
+                 && file_tell (in) < file_tell (out) + (off_t) length
+                 && file_tell (out) < file_tell (in) + (off_t) length))
+        result = file_copy (out, in, length);
+    }
+  sema_up (&filesys_sema);
+
+  return result;
+}
+
+/* Writes FD's dirty data and index sectors to disk and commits
+   its metadata.  The sector list is gathered under
+   filesys_sema, but the flush itself runs without it so that
+   concurrent callers can share one.  Returns 0 on success, -1
+   if FD is not open. */
+static int
+fsync (int fd)
+{
+  struct file *file;
+  block_sector_t *sectors = NULL;
+  size_t cnt = 0;
+
+  sema_down (&filesys_sema);
+  file = find_file (fd);
+  if (file != NULL)
+    sectors = inode_sectors (file_get_inode (file), &cnt);
+  sema_up (&filesys_sema);
+  if (file == NULL)
+    return -1;
+
+  /* Without a sector list, fall back to flushing everything. */
+  buffer_cache_sync (sectors, cnt);
+  free (sectors);
+  return 0;
+}
+
+/* Writes every dirty cached sector to disk. */
+static void
+sync (void)
+{
+  buffer_cache_sync (NULL, 0);
+}
+
 #ifdef VM
 static mapid_t 
 mmap (int fd, void* upage)
@@ -455,17 +1051,11 @@ mmap (int fd, void* upage)
   int file_size = file_length(new_file);
   if (file_size == 0) goto fail;
 
-  //check sup page entry
+  //reserve the whole file; fails if any page is already in use
   struct thread *t = thread_current();
-  for(int i=0; i<file_size; i=i+PGSIZE){
-    if(sup_page_table_has_entry(t->spt, (upage+i))) goto fail;
-  }
-  
-  //sup page make 이제부터 fail case가 없음
-  for(int offset=0; offset<file_size; offset=offset+PGSIZE){
-    size_t page_read_bytes = file_size-offset>PGSIZE ? PGSIZE : file_size-offset;
-    size_t page_zero_bytes = PGSIZE-page_read_bytes;
-    sup_page_reserve_segment(upage+offset, new_file, offset, page_read_bytes, page_zero_bytes, true);
+  if (!sup_page_reserve_range (upage, file_size, new_file, 0, file_size, true)){
+    file_close(new_file);
+    goto fail;
   }
   
   //check finish. make map_desc
@@ -491,35 +1081,32 @@ munmap(mapid_t mapid)
   sema_up(&filesys_sema);
 }
 
-static void check_pd (const void *uaddr)
+/* Writes the dirty pages of MAPID back to its file, keeping the
+   mapping.  Returns 0 if successful, -1 if MAPID is not mapped. */
+static int
+msync (mapid_t mapid)
 {
-  void *upage;
-  uint32_t *pd = thread_current()->pagedir;
-  upage = pg_round_down (uaddr);
-  if (pagedir_get_page (pd, upage) == NULL)
-  {
-    exit (-1);
-  }
-}
+  struct map_desc *mdesc;
+  int ofs;
 
-void
-load_and_pin_buffer (const void *buffer, unsigned length)
-{
-  void *upage;
-  for(upage = pg_round_down (buffer); upage < buffer + length; upage += PGSIZE)
+  sema_down (&filesys_sema);
+  mdesc = find_map_desc (mapid);
+  if (mdesc == NULL)
   {
-    sup_page_load_page_and_pin (upage, true, true);
+    sema_up (&filesys_sema);
+    return -1;
   }
+  for (ofs = 0; ofs < mdesc->size; ofs += PGSIZE)
+    sup_page_write_back (mdesc->address + ofs);
+  sema_up (&filesys_sema);
+  return 0;
 }
 
-void
-unpin_buffer (const void *buffer, unsigned length)
+static int
+fork (void)
 {
-  void *upage;
-  for(upage = pg_round_down (buffer); upage < buffer + length; upage += PGSIZE)
-  {
-    sup_page_update_frame_pinned (upage, false);
-  }
+  tid_t tid = process_fork (thread_current ()->syscall_frame);
+  return tid == TID_ERROR ? -1 : tid;
 }
 #endif
 #ifdef FILESYS
@@ -548,25 +1135,21 @@ static bool mkdir (const char *path)
 
 static bool readdir (int fd, char *name)
 {
-  struct file *file;
-  struct inode *inode;
-  bool is_dir;
+  char kname[NAME_MAX + 1];
   struct dir *dir;
   bool success = false;
 
-  if (strlen(name) > NAME_MAX) {
-    return false;
-  }
-
   sema_down (&filesys_sema);
 
   dir = fd_open_dir (fd);
 
   if (dir != NULL){
-    success = dir_readdir (dir, name);
+    success = dir_readdir (dir, kname);
   }
 
   sema_up (&filesys_sema);
+  if (success)
+    store_user (name, kname, strlen (kname) + 1);
   return success;
 }
 
@@ -605,4 +1188,28 @@ static int inumber(int fd)
   sema_up (&filesys_sema);
   return result;
 }
-#endif
\ No newline at end of file
+#endif
+
+/* Copies the most recent kernel output, up to SIZE bytes, into
+   user BUFFER.  Kills the process if BUFFER is bad.  Returns the
+   number of bytes copied, or -1. */
+static int
+dmesg (char *buffer, unsigned size)
+{
+  char *kbuf;
+  size_t bytes;
+
+  if (size > CONSOLE_LOG_SIZE)
+    size = CONSOLE_LOG_SIZE;
+  kbuf = malloc (size);
+  if (kbuf == NULL)
+    return -1;
+  bytes = console_dump (kbuf, size);
+  if (!copy_to_user (buffer, kbuf, bytes))
+  {
+    free (kbuf);
+    exit (-1);
+  }
+  free (kbuf);
+  return bytes;
+}
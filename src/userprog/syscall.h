@@ -1,9 +1,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+
 void syscall_init (void);
 void sema_up_filesys (void);
 void sema_down_filesys (void);
+bool sema_try_down_filesys (void);
 void exit (int status);
 
 #endif /* userprog/syscall.h */
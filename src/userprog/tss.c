@@ -1,5 +1,6 @@
 #include "userprog/tss.h"
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
 #include "threads/thread.h"
@@ -75,6 +76,19 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* SYSENTER model-specific registers.  See [IA32-v3a] 4.8.7
+   "Performing Fast Calls to System Procedures with the SYSENTER
+   and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* Fast system call entry point, in userprog/sysenter.S. */
+void sysenter_entry (void);
+
+static bool cpu_has_sysenter (void);
+static void write_msr (uint32_t msr, uint32_t value);
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +100,17 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* Let user programs enter the kernel with sysenter.  The stack
+     pointer it loads is the TSS itself: sysenter_entry picks up
+     the current thread's kernel stack from tss->esp0, so nothing
+     has to change here on a thread switch. */
+  if (cpu_has_sysenter ())
+    {
+      write_msr (MSR_SYSENTER_CS, SEL_KCSEG);
+      write_msr (MSR_SYSENTER_ESP, (uint32_t) tss);
+      write_msr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
 }
 
 /* Returns the kernel TSS. */
@@ -104,3 +129,27 @@ tss_update (void)
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
+
+/* Returns true if the CPU implements sysenter and sysexit.
+   Early Pentium Pro steppings report the feature without
+   supporting it. */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return (edx & (1u << 11)) != 0
+         && !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* Writes VALUE to model-specific register MSR. */
+static void
+write_msr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
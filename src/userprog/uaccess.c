@@ -0,0 +1,96 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Adds an exception table entry: a page fault at instruction
+   FROM resumes at TO.  See exception_fixup(). */
+#define EX_TABLE(FROM, TO)                      \
+  ".pushsection __ex_table, \"a\"\n"            \
+  ".long " FROM ", " TO "\n"                    \
+  ".popsection\n"
+
+/* Returns true if the SIZE bytes starting at UADDR lie below
+   PHYS_BASE.  Whether they are mapped is left to the MMU. */
+static bool
+user_range_ok (const void *uaddr, size_t size)
+{
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  return end >= (const uint8_t *) uaddr
+         && (size == 0 || is_user_vaddr (end - 1));
+}
+
+/* Copies SIZE bytes at SRC to DST with "rep movsb".  If DST or
+   SRC faults partway, the copy stops there.  Returns the number
+   of bytes left uncopied. */
+static size_t
+copy_bytes (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                EX_TABLE ("1b", "2b")
+                : "+c" (size), "+D" (dst), "+S" (src)
+                :
+                : "memory");
+  return size;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   KDST.  Returns true if successful, false if USRC is not a
+   valid user buffer. */
+bool
+copy_from_user (void *kdst, const void *usrc, size_t size)
+{
+  return user_range_ok (usrc, size) && copy_bytes (kdst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel address KSRC to user address
+   UDST.  Returns true if successful, false if UDST is not a
+   valid, writable user buffer. */
+bool
+copy_to_user (void *udst, const void *ksrc, size_t size)
+{
+  return user_range_ok (udst, size) && copy_bytes (udst, ksrc, size) == 0;
+}
+
+/* Reads the byte at user address UADDR into *BYTE.  Returns
+   true if successful, false if UADDR faults. */
+static inline bool
+get_user (uint8_t *byte, const uint8_t *uaddr)
+{
+  uint32_t ok = 1;
+  uint32_t value;
+
+  asm volatile ("1: movzbl %2, %1\n"
+                "2:\n"
+                ".pushsection .fixup, \"ax\"\n"
+                "3: xorl %0, %0\n"
+                "   jmp 2b\n"
+                ".popsection\n"
+                EX_TABLE ("1b", "3b")
+                : "+r" (ok), "=r" (value)
+                : "m" (*uaddr));
+  *byte = value;
+  return ok;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   KDST, which has room for SIZE bytes including the null
+   terminator.  Returns the length of the string, or -1 if USRC
+   faults or the string does not fit. */
+int
+strncpy_from_user (char *kdst, const char *usrc, size_t size)
+{
+  const uint8_t *src = (const uint8_t *) usrc;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      uint8_t c;
+      if (!is_user_vaddr (src + i) || !get_user (&c, src + i))
+        return -1;
+      kdst[i] = c;
+      if (c == '\0')
+        return i;
+    }
+  return -1;
+}
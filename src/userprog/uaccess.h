@@ -0,0 +1,14 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Access to user memory from the kernel.  These touch user
+   memory directly; a fault on a bad address is caught through
+   the exception fixup table and reported as failure. */
+bool copy_from_user (void *kdst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *ksrc, size_t size);
+int strncpy_from_user (char *kdst, const char *usrc, size_t size);
+
+#endif /* userprog/uaccess.h */
@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Runs the paging stress tests under each eviction policy and
+# reports page faults and evictions per test, followed by the
+# totals for each policy.  The table is also saved in
+# evict_bench.txt next to this script.
+
+cd "$( dirname "${BASH_SOURCE[0]}" )"
+
+policies="clock clock2 aging lru"
+tests="page-merge-seq page-merge-par page-merge-stk page-merge-mm page-parallel"
+
+make -j 8 > /dev/null || exit 1
+{
+  printf "%-16s %-8s %-6s %10s %10s\n" test policy result faults evictions
+  for policy in $policies
+  do
+    total_faults=0
+    total_evictions=0
+    for t in $tests
+    do
+      rm -f build/tests/vm/$t.output build/tests/vm/$t.result
+      make build/tests/vm/$t.result KERNELFLAGS=-evict=$policy > /dev/null 2>&1
+      result=$(head -1 build/tests/vm/$t.result)
+      faults=$(sed -n 's/^Exception: \([0-9]*\) page faults/\1/p' build/tests/vm/$t.output)
+      evictions=$(sed -n 's/^Frames: \([0-9]*\) evictions.*/\1/p' build/tests/vm/$t.output)
+      printf "%-16s %-8s %-6s %10s %10s\n" $t $policy "$result" "$faults" "$evictions"
+      total_faults=$((total_faults + ${faults:-0}))
+      total_evictions=$((total_evictions + ${evictions:-0}))
+    done
+    printf "%-16s %-8s %-6s %10s %10s\n" total $policy "" $total_faults $total_evictions
+  done
+} | tee evict_bench.txt
@@ -1,6 +1,10 @@
 #include <stdio.h>
-#include <hash.h>
+#include <round.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/file.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "threads/palloc.h"
@@ -11,123 +15,801 @@
 #include "vm/swap.h"
 
 static struct lock frame_table_lock;
-static struct hash frame_table;
+
+/* Frame table: one entry per user pool page, FRAME_CNT in all,
+   the first describing the page at USER_BASE. */
+static struct frame_table_entry *frame_table;
+static size_t frame_cnt;
+static uint8_t *user_base;
+
+/* Page replacement policies, selected with the -evict option. */
+enum evict_policy
+  {
+    EVICT_CLOCK,                /* Clock (second chance). */
+    EVICT_CLOCK2,               /* Two-handed clock. */
+    EVICT_AGING,                /* Aging (NFU with decay). */
+    EVICT_LRU                   /* Approximate LRU by access time. */
+  };
+
+static const char *policy_names[] = {"clock", "clock2", "aging", "lru"};
+static enum evict_policy policy = EVICT_CLOCK;
+
+/* Where the next sweep of the frame table starts.  For the
+   two-handed clock this is the back hand, and the front hand
+   runs CLOCK2_SPREAD frames ahead of it. */
+static size_t clock_hand;
+#define CLOCK2_SPREAD (frame_cnt / 4 > 0 ? frame_cnt / 4 : 1)
+
+/* Number of frames evicted. */
+static long long evict_cnt;
+
+/* Number of frames in use. */
+static size_t used_cnt;
+
+/* Page-out daemon.  When fewer than LOW_WATER frames are free,
+   allocators signal PAGEOUT_COND, and the daemon evicts frames
+   in batches of PAGEOUT_BATCH until HIGH_WATER frames are free.
+   It unmaps a batch and marks its frames EVICTING under
+   frame_table_lock, writes the dirty ones to their mapped files
+   or to swap without the lock, then frees them.  Threads that need one of those frames
+   in the meantime wait on EVICT_DONE. */
+#define PAGEOUT_BATCH 8
+static size_t low_water, high_water;
+static struct condition pageout_cond;
+static struct condition evict_done;
+
+/* Number of frames marked EVICTING. */
+static size_t evicting_cnt;
+
+/* Page cache: frames holding clean, read-only file pages, hashed
+   by inode and offset.  Segments may share a file page but read
+   different amounts of it, so the key also includes the number
+   of bytes read.  A frame stays in the cache while some
+   process maps it. */
+static struct hash page_cache;
+
+/* Where an evicted page goes. */
+enum evict_target
+  {
+    EVICT_DROP,                 /* Clean: read back from its file. */
+    EVICT_SWAP,                 /* Written to a swap slot. */
+    EVICT_FILE                  /* Written back to its mapped file. */
+  };
+
+static struct frame_table_entry *choose_victim (void);
 
 static unsigned
-frame_hash_func (const struct hash_elem *elem, void *aux UNUSED)
+cache_hash (const struct hash_elem *e, void *aux UNUSED)
 {
-  struct frame_table_entry *frame_entry = hash_entry (elem, struct frame_table_entry, h_elem);
-  return hash_bytes((void *) &frame_entry->frame, sizeof frame_entry->frame);
+  const struct frame_table_entry *fte
+    = hash_entry (e, struct frame_table_entry, cache_elem);
+  return hash_int ((int) fte->inode ^ fte->ofs ^ fte->read_bytes);
 }
+
 static bool
-frame_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
 {
-  struct frame_table_entry *a_entry = hash_entry (a, struct frame_table_entry, h_elem);
-  struct frame_table_entry *b_entry = hash_entry (b, struct frame_table_entry, h_elem);
-  return a_entry->frame < b_entry->frame;
+  const struct frame_table_entry *a
+    = hash_entry (a_, struct frame_table_entry, cache_elem);
+  const struct frame_table_entry *b
+    = hash_entry (b_, struct frame_table_entry, cache_elem);
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
 }
 
 /*
  * Initialize frame table
+ * Called after palloc_init(), so that the user pool size is known.
  */
 void 
 frame_init (void)
 {
+  size_t table_pages;
+
   lock_init (&frame_table_lock);
-  hash_init (&frame_table, frame_hash_func, frame_less_func, NULL);
+  cond_init (&pageout_cond);
+  cond_init (&evict_done);
+  frame_cnt = palloc_user_pool (&user_base);
+  table_pages = DIV_ROUND_UP (frame_cnt * sizeof *frame_table, PGSIZE);
+  frame_table = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, table_pages);
+  low_water = frame_cnt / 16;
+  high_water = frame_cnt / 8;
+  hash_init (&page_cache, cache_hash, cache_less, NULL);
+}
+
+/* Returns the frame table slot for user pool page KPAGE. */
+static struct frame_table_entry *
+frame_slot (void *kpage)
+{
+  size_t idx = pg_no (kpage) - pg_no (user_base);
+
+  ASSERT (pg_ofs (kpage) == 0);
+  ASSERT (idx < frame_cnt);
+  return &frame_table[idx];
 }
 
 struct frame_table_entry*
 get_frame_table_entry (void *kpage)
 {
-  struct frame_table_entry tmp_fte;
-  tmp_fte.frame = (void *) vtop (kpage);
+  struct frame_table_entry *fte = frame_slot (kpage);
 
-  struct hash_elem *elem = hash_find (&frame_table, &tmp_fte.h_elem);
-  if (elem == NULL) return NULL;
-  return hash_entry (elem, struct frame_table_entry, h_elem);
+  return fte->kpage != NULL ? fte : NULL;
 }
 
-/* 
- * Make a new frame table entry for addr.
+/*
+ * Unmap the page in FTE from every process that maps it, found
+ * through its sharers, and decide where it goes.  Pages of
+ * memory-mapped files, the only writable pages with a backing
+ * file, go back to the file.  Must acquire frame_table_lock
+ * beforehand.
  */
-void *
-allocate_frame_and_pin (enum palloc_flags flags, void *upage, bool pinned)
+static enum evict_target
+evict_begin (struct frame_table_entry *fte)
 {
-  ASSERT (flags & PAL_USER)
-  uint8_t *kpage;
-  struct sup_page_table_entry *spte;
-  struct frame_table_entry *fte;
-  size_t swap_index;
+  uint32_t *pd = fte->owner->pagedir;
+  struct sup_page_table_entry *spte = fte->spte;
+  struct list_elem *e;
+  bool dirty;
 
-  lock_acquire (&frame_table_lock);
-  kpage = palloc_get_page (flags);
-  // Allocation failed
-  if (kpage == NULL) {
-#ifdef VM_SWAP_H
-    fte = select_victim_frame ();
-    spte = fte->spte;
-    pagedir_clear_page (fte->owner->pagedir, fte->upage);
-    kpage = fte->kpage;
-    // dirty check
-    if (pagedir_is_dirty (fte->owner->pagedir, fte->upage) || spte->writable) {
-      swap_index = swap_out (kpage);
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct sup_page_table_entry *spte
+      = list_entry (e, struct sup_page_table_entry, frame_elem);
+    pagedir_clear_page (spte->owner->pagedir, spte->upage);
+  }
+
+  dirty = pagedir_is_dirty (pd, fte->upage) || spte->dirty;
+  if (spte->file != NULL && spte->writable)
+    return dirty ? EVICT_FILE : EVICT_DROP;
+  if (spte->file != NULL && !dirty)
+    return EVICT_DROP;
+  return EVICT_SWAP;
+}
+
+/*
+ * Write the page in FTE back to its memory-mapped file: only the
+ * part inside the file.  Returns false, and the page goes to swap
+ * instead, if the file system is busy, since whoever holds it may
+ * be waiting for this very frame.
+ */
+static bool
+write_back (struct frame_table_entry *fte)
+{
+  struct sup_page_table_entry *spte = fte->spte;
+
+  if (!sema_try_down_filesys ())
+    return false;
+  file_write_at (spte->file, fte->kpage, spte->file_page_read_bytes,
+                 spte->file_offset);
+  sema_up_filesys ();
+  return true;
+}
+
+/*
+ * Record where the page evicted from FTE now lives, and free the
+ * frame table entry.  Must acquire frame_table_lock beforehand.
+ */
+static void
+evict_end (struct frame_table_entry *fte, enum evict_target target,
+           size_t swap_index)
+{
+  struct list_elem *e;
+
+  /* A page shared copy-on-write goes to one swap slot, which
+     every sharer refers to; each gets a private copy back. */
+  if (target == EVICT_SWAP && fte->refcnt > 1)
+    swap_dup (swap_index, fte->refcnt - 1);
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct sup_page_table_entry *spte
+      = list_entry (e, struct sup_page_table_entry, frame_elem);
+    if (target == EVICT_SWAP) {
       spte->source = SWAP;
       spte->swap_index = swap_index;
       spte->dirty = true;
     } else {
       spte->source = FILE_SYS;
-    };
+      spte->dirty = false;
+    }
     spte->on_frame = false;
-    free_frame_with_lock (kpage);
-#else
-    return NULL;
-#endif
+    spte->cow = false;
+  }
+  evict_cnt++;
+  free_frame_with_lock (fte->kpage);
+}
+
+/* Returns true if frame A should come before frame B in swap:
+   grouped by owner, then in address order. */
+static bool
+swap_order_less (const struct frame_table_entry *a,
+                 const struct frame_table_entry *b)
+{
+  if (a->owner != b->owner)
+    return a->owner->tid < b->owner->tid;
+  return a->upage < b->upage;
+}
+
+/*
+ * Write the N pages in BATCH to swap, storing their slots in
+ * SWAP_INDEX.  BATCH is sorted with swap_order_less(), and each
+ * owner's run of pages goes to one cluster of swap slots.
+ */
+static void
+swap_out_batch (struct frame_table_entry **batch, size_t n,
+                size_t *swap_index)
+{
+  size_t start, i;
+
+  for (start = 0; start < n; start = i)
+  {
+    void *pages[PAGEOUT_BATCH];
+
+    for (i = start; i < n && batch[i]->owner == batch[start]->owner; i++)
+      pages[i - start] = batch[i]->kpage;
+    swap_out_cluster (pages, i - start, batch[start]->owner->tid,
+                      swap_index + start);
+  }
+}
+
+/*
+ * Evict one batch of frames, as described at the top of this
+ * file.  Returns false if no frame could be evicted.
+ * Must acquire frame_table_lock beforehand.
+ */
+static bool
+pageout_batch (void)
+{
+  struct frame_table_entry *batch[PAGEOUT_BATCH];
+  struct frame_table_entry *dirty[PAGEOUT_BATCH];
+  enum evict_target target[PAGEOUT_BATCH];
+  size_t swap_index[PAGEOUT_BATCH];
+  size_t dirty_index[PAGEOUT_BATCH];
+  size_t n = 0, dirty_cnt = 0, i, j;
+
+  while (n < PAGEOUT_BATCH && frame_cnt - used_cnt + n < high_water)
+  {
+    struct frame_table_entry *fte = choose_victim ();
+    if (fte == NULL)
+      break;
+    fte->evicting = true;
+    evicting_cnt++;
+    target[n] = evict_begin (fte);
+    batch[n++] = fte;
   }
+  if (n == 0)
+    return false;
 
-  fte = malloc (sizeof (struct frame_table_entry));
-  // TODO : Check validity ?
+  lock_release (&frame_table_lock);
+
+  for (i = 0; i < n; i++)
+    if (target[i] == EVICT_FILE && !write_back (batch[i]))
+      target[i] = EVICT_SWAP;
+
+  /* Insertion sort the frames bound for swap into swap order. */
+  for (i = 0; i < n; i++)
+    if (target[i] == EVICT_SWAP)
+    {
+      for (j = dirty_cnt++; j > 0 && swap_order_less (batch[i], dirty[j - 1]);
+           j--)
+        dirty[j] = dirty[j - 1];
+      dirty[j] = batch[i];
+    }
+
+  swap_out_batch (dirty, dirty_cnt, dirty_index);
+  lock_acquire (&frame_table_lock);
+
+  for (i = 0; i < n; i++)
+    if (target[i] == EVICT_SWAP)
+      for (j = 0; j < dirty_cnt; j++)
+        if (dirty[j] == batch[i])
+          swap_index[i] = dirty_index[j];
+
+  for (i = 0; i < n; i++)
+  {
+    void *kpage = batch[i]->kpage;
+    batch[i]->evicting = false;
+    evicting_cnt--;
+    evict_end (batch[i], target[i], swap_index[i]);
+    palloc_free_page (kpage);
+  }
+  cond_broadcast (&evict_done, &frame_table_lock);
+  return true;
+}
+
+/* Page-out daemon. */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  lock_acquire (&frame_table_lock);
+  for (;;)
+  {
+    while (frame_cnt - used_cnt >= low_water)
+      cond_wait (&pageout_cond, &frame_table_lock);
+    while (frame_cnt - used_cnt < high_water)
+      if (!pageout_batch ())
+        break;
+    if (frame_cnt - used_cnt < low_water)
+      cond_wait (&pageout_cond, &frame_table_lock);
+  }
+}
+
+/*
+ * Start the page-out daemon.
+ * Called once the swap device is ready.
+ */
+void
+frame_start_pageout (void)
+{
+  thread_create ("pageoutd", PRI_DEFAULT, pageout_daemon, NULL);
+}
+
+/*
+ * Wait until the frame at kpage is no longer being paged out.
+ */
+void
+frame_wait_pageout (void *kpage)
+{
+  struct frame_table_entry *fte = frame_slot (kpage);
+
+  lock_acquire (&frame_table_lock);
+  while (fte->evicting)
+    cond_wait (&evict_done, &frame_table_lock);
+  lock_release (&frame_table_lock);
+}
+
+/* 
+ * Make a new frame table entry for addr.
+ * Normally the page-out daemon keeps free frames available; if
+ * there are none, evict one synchronously.  If every evictable
+ * frame is in the daemon's batch, wait for the batch to finish.
+ * Returns a null pointer if no frame can be evicted at all.
+ * Must acquire frame_table_lock beforehand.
+ */
+static void *
+get_frame (enum palloc_flags flags, void *upage, bool pinned)
+{
+  uint8_t *kpage;
+  struct frame_table_entry *fte;
+
+  // Allocation failed
+  while ((kpage = palloc_get_page (flags)) == NULL) {
+    enum evict_target target;
+    size_t swap_index = 0;
+
+    fte = choose_victim ();
+    if (fte == NULL) {
+      if (evicting_cnt == 0)
+        return NULL;
+      cond_wait (&evict_done, &frame_table_lock);
+      continue;
+    }
+    kpage = fte->kpage;
+    target = evict_begin (fte);
+    if (target == EVICT_FILE && !write_back (fte))
+      target = EVICT_SWAP;
+    if (target == EVICT_SWAP)
+      swap_index = swap_out (kpage, fte->owner->tid);
+    evict_end (fte, target, swap_index);
+    if (flags & PAL_ZERO)
+      memset (kpage, 0, PGSIZE);
+    break;
+  }
+
+  used_cnt++;
+  if (frame_cnt - used_cnt < low_water)
+    cond_signal (&pageout_cond, &frame_table_lock);
+
+  fte = frame_slot (kpage);
   fte->owner = thread_current ();
-  fte->frame = (void *) vtop (kpage);
-  // TODO: supplementary table ?
-  fte->kpage = kpage; // TODO: vaddr?
+  fte->spte = NULL;
+  fte->kpage = kpage;
   fte->upage = upage;
-  fte->pinned = pinned;
+  fte->pin_cnt = pinned ? 1 : 0;
+  fte->evicting = false;
+  fte->age = 0;
+  return kpage;
+}
 
-  hash_insert (&frame_table, &fte->h_elem);
-  lock_release (&frame_table_lock);
+/* Make a new frame table entry for addr, as get_frame().
+   Returns a null pointer if memory runs out. */
+void *
+allocate_frame_and_pin (enum palloc_flags flags, void *upage, bool pinned)
+{
+  ASSERT (flags & PAL_USER)
+  void *kpage;
 
+  lock_acquire (&frame_table_lock);
+  kpage = get_frame (flags, upage, pinned);
+  lock_release (&frame_table_lock);
   return kpage;
 }
 
+/*
+ * Allocate pinned frames for the CNT pages in UPAGES into KPAGES,
+ * under one acquisition of frame_table_lock.  Returns the number
+ * allocated, which is less than CNT if memory runs out.
+ */
+size_t
+allocate_frames_and_pin (enum palloc_flags flags, void *upages[],
+                         void *kpages[], size_t cnt)
+{
+  ASSERT (flags & PAL_USER)
+  size_t i;
+
+  lock_acquire (&frame_table_lock);
+  for (i = 0; i < cnt; i++)
+  {
+    kpages[i] = get_frame (flags, upages[i], true);
+    if (kpages[i] == NULL)
+      break;
+  }
+  lock_release (&frame_table_lock);
+  return i;
+}
+
 void *
 allocate_frame (enum palloc_flags flags, void *upage)
 {
   return allocate_frame_and_pin (flags, upage, false);
 }
 
+/*
+ * Returns true if enough frames are free that allocating a few
+ * more will not start the page-out daemon.  Only a hint: the
+ * count may change as soon as this returns.
+ */
+bool
+frame_has_spare (void)
+{
+  return frame_cnt - used_cnt >= high_water + PAGEOUT_BATCH;
+}
+
 void
 fte_update_pinned (void *kpage, bool pinned)
 {
   struct frame_table_entry *fte = get_frame_table_entry (kpage);
-  fte->pinned = pinned;
+
+  lock_acquire (&frame_table_lock);
+  if (pinned)
+    fte->pin_cnt++;
+  else
+  {
+    ASSERT (fte->pin_cnt > 0);
+    fte->pin_cnt--;
+  }
+  lock_release (&frame_table_lock);
+}
+
+/* Makes SPTE the only mapping of FTE. */
+static void
+attach_spte (struct frame_table_entry *fte, struct sup_page_table_entry *spte)
+{
+  fte->spte = spte;
+  fte->refcnt = 1;
+  list_init (&fte->sharers);
+  list_push_back (&fte->sharers, &spte->frame_elem);
+  spte->access_time = timer_ticks ();
+}
+
+/*
+ * Pin spte's page if it is in memory, waiting for the page-out
+ * daemon if it is evicting the page.  Returns false if the page
+ * is not in memory.
+ */
+bool
+frame_pin (struct sup_page_table_entry *spte)
+{
+  bool pinned = false;
+
+  lock_acquire (&frame_table_lock);
+  while (spte->on_frame && frame_slot (spte->kpage)->evicting)
+    cond_wait (&evict_done, &frame_table_lock);
+  if (spte->on_frame)
+  {
+    frame_slot (spte->kpage)->pin_cnt++;
+    pinned = true;
+  }
+  lock_release (&frame_table_lock);
+  return pinned;
+}
+
+/*
+ * Pin the frames of those of the CNT pages in SPTES that are in
+ * memory, under one acquisition of frame_table_lock, and set
+ * their entries in SPTES to NULL.  Null entries are skipped.
+ * Returns the number of pages pinned.
+ */
+size_t
+frame_pin_batch (struct sup_page_table_entry *sptes[], size_t cnt)
+{
+  size_t pinned = 0;
+  size_t i;
+
+  lock_acquire (&frame_table_lock);
+  for (i = 0; i < cnt; i++)
+  {
+    struct sup_page_table_entry *spte = sptes[i];
+
+    if (spte == NULL)
+      continue;
+    while (spte->on_frame && frame_slot (spte->kpage)->evicting)
+      cond_wait (&evict_done, &frame_table_lock);
+    if (spte->on_frame)
+    {
+      frame_slot (spte->kpage)->pin_cnt++;
+      sptes[i] = NULL;
+      pinned++;
+    }
+  }
+  lock_release (&frame_table_lock);
+  return pinned;
+}
+
+/*
+ * Unpin the frames of the CNT pages in SPTES, under one
+ * acquisition of frame_table_lock.  Null entries and pages not in
+ * memory are skipped.
+ */
+void
+frame_unpin_batch (struct sup_page_table_entry *sptes[], size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&frame_table_lock);
+  for (i = 0; i < cnt; i++)
+    if (sptes[i] != NULL && sptes[i]->on_frame)
+    {
+      struct frame_table_entry *fte = frame_slot (sptes[i]->kpage);
+      ASSERT (fte->pin_cnt > 0);
+      fte->pin_cnt--;
+    }
+  lock_release (&frame_table_lock);
 }
 
 void
 fte_install_spte (void *kpage, struct sup_page_table_entry *spte)
 {
-  struct frame_table_entry *fte = get_frame_table_entry (kpage);
-  fte->spte = spte;
+  attach_spte (get_frame_table_entry (kpage), spte);
+}
+
+/*
+ * Remove SPTE's mapping of FTE, which other processes still
+ * share, and let another sharer stand for the frame.
+ * Must acquire frame_table_lock beforehand.
+ */
+static void
+drop_sharer (struct frame_table_entry *fte, struct sup_page_table_entry *spte)
+{
+  struct sup_page_table_entry *next;
+
+  ASSERT (fte->refcnt > 1);
+  list_remove (&spte->frame_elem);
+  fte->refcnt--;
+  pagedir_clear_page (spte->owner->pagedir, spte->upage);
+
+  next = list_entry (list_front (&fte->sharers),
+                     struct sup_page_table_entry, frame_elem);
+  fte->owner = next->owner;
+  fte->upage = next->upage;
+  fte->spte = next;
 }
 
+/*
+ * Free the current thread's frame at kpage.  If the page-out
+ * daemon is evicting it, wait for that to finish instead: the
+ * daemon frees the frame itself.  If other processes share the
+ * frame, only unmap it from the current one.
+ */
 void
 free_frame (void *kpage)
 {
+  struct frame_table_entry *fte = frame_slot (kpage);
+  struct thread *cur = thread_current ();
+
   lock_acquire (&frame_table_lock);
-  free_frame_with_lock (kpage);
+  while (fte->evicting)
+    cond_wait (&evict_done, &frame_table_lock);
+  if (fte->kpage != NULL && fte->refcnt > 1)
+  {
+    struct list_elem *e;
+
+    for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+         e = list_next (e))
+    {
+      struct sup_page_table_entry *spte
+        = list_entry (e, struct sup_page_table_entry, frame_elem);
+      if (spte->owner == cur)
+      {
+        drop_sharer (fte, spte);
+        break;
+      }
+    }
+  }
+  else if (fte->kpage != NULL && fte->owner == cur)
+    free_frame_with_lock (kpage);
   lock_release (&frame_table_lock);
 }
 
+/*
+ * Map the frame holding spte's page into new_spte's process as
+ * well, for fork().  If the page is writable, both processes get
+ * it read-only and copy it on their first write.  A pinned,
+ * writable page is copied for new_spte's process right away
+ * instead.  Leaves new_spte off its frame if the page is not in
+ * memory.  Returns false if memory runs out.
+ */
+bool
+frame_share (struct sup_page_table_entry *spte,
+             struct sup_page_table_entry *new_spte)
+{
+  struct frame_table_entry *fte;
+  void *kpage;
+
+  lock_acquire (&frame_table_lock);
+  while (spte->on_frame && frame_slot (spte->kpage)->evicting)
+    cond_wait (&evict_done, &frame_table_lock);
+  if (spte->on_frame && spte->writable
+      && frame_slot (spte->kpage)->pin_cnt > 0)
+  {
+    /* The kernel writes to pinned pages, such as AIO buffers,
+       through their frames, so they must not be shared.  The pin
+       keeps the page in its frame while get_frame() waits. */
+    kpage = get_frame (PAL_USER, new_spte->upage, true);
+    if (kpage == NULL)
+    {
+      lock_release (&frame_table_lock);
+      return false;
+    }
+    memcpy (kpage, spte->kpage, PGSIZE);
+    fte = frame_slot (kpage);
+    fte->owner = new_spte->owner;
+    attach_spte (fte, new_spte);
+    fte->pin_cnt = 0;
+    new_spte->kpage = kpage;
+    new_spte->on_frame = true;
+    new_spte->dirty = true;
+  }
+  else if (spte->on_frame)
+  {
+    fte = frame_slot (spte->kpage);
+    if (spte->writable)
+    {
+      spte->cow = new_spte->cow = true;
+      pagedir_set_writable (spte->owner->pagedir, spte->upage, false);
+    }
+    new_spte->kpage = spte->kpage;
+    new_spte->on_frame = true;
+    list_push_back (&fte->sharers, &new_spte->frame_elem);
+    fte->refcnt++;
+  }
+  lock_release (&frame_table_lock);
+  return true;
+}
+
+/*
+ * Give spte its own writable mapping of fte, the frame holding its
+ * copy-on-write page.  The last sharer takes the frame over;
+ * otherwise the page is copied to kpage, which must be allocated,
+ * and spte's pins move along with it.  Returns true if kpage was
+ * used.
+ * Must acquire frame_table_lock beforehand.
+ */
+static bool
+unshare_locked (struct frame_table_entry *fte,
+                struct sup_page_table_entry *spte, void *kpage)
+{
+  uint32_t *pd = spte->owner->pagedir;
+
+  spte->cow = false;
+  if (fte->refcnt == 1)
+  {
+    pagedir_set_writable (pd, spte->upage, true);
+    fte->owner = spte->owner;
+    fte->upage = spte->upage;
+    fte->spte = spte;
+    return false;
+  }
+  ASSERT (kpage != NULL);
+  memcpy (kpage, spte->kpage, PGSIZE);
+  drop_sharer (fte, spte);
+  pagedir_set_page (pd, spte->upage, kpage, true);
+  spte->kpage = kpage;
+  attach_spte (frame_slot (kpage), spte);
+  frame_slot (kpage)->pin_cnt += fte->pin_cnt;
+  fte->pin_cnt = 0;
+  return true;
+}
+
+/*
+ * Give spte's process a private, writable copy of its
+ * copy-on-write page.  The last sharer takes the frame over
+ * without copying.  Returns false if memory runs out.
+ */
+bool
+frame_unshare (struct sup_page_table_entry *spte)
+{
+  struct frame_table_entry *fte;
+  void *kpage = NULL;
+
+  lock_acquire (&frame_table_lock);
+  for (;;)
+  {
+    if (!spte->on_frame)
+    {
+      /* Paged out meanwhile: it comes back as a private copy. */
+      spte->cow = false;
+      fte = NULL;
+      break;
+    }
+    fte = frame_slot (spte->kpage);
+    if (fte->evicting)
+      cond_wait (&evict_done, &frame_table_lock);
+    else if (fte->refcnt == 1 || kpage != NULL)
+      break;
+    else
+    {
+      lock_release (&frame_table_lock);
+      kpage = allocate_frame_and_pin (PAL_USER, spte->upage, true);
+      if (kpage == NULL)
+        return false;
+      lock_acquire (&frame_table_lock);
+    }
+  }
+
+  if (fte != NULL && unshare_locked (fte, spte, kpage))
+  {
+    /* Drop the pin taken by allocate_frame_and_pin(). */
+    frame_slot (kpage)->pin_cnt--;
+    kpage = NULL;
+  }
+
+  /* Not needed after all. */
+  if (kpage != NULL)
+  {
+    free_frame_with_lock (kpage);
+    palloc_free_page (kpage);
+  }
+  lock_release (&frame_table_lock);
+  return true;
+}
+
+/*
+ * Like frame_unshare(), but copy into kpage, a frame allocated by
+ * allocate_frames_and_pin(), and leave spte's page pinned.  kpage
+ * is released if the frame is taken over instead.  Returns false,
+ * leaving kpage alone, if the page is no longer in memory.
+ */
+bool
+frame_unshare_into (struct sup_page_table_entry *spte, void *kpage)
+{
+  struct frame_table_entry *fte;
+
+  lock_acquire (&frame_table_lock);
+  while (spte->on_frame && frame_slot (spte->kpage)->evicting)
+    cond_wait (&evict_done, &frame_table_lock);
+  if (!spte->on_frame)
+  {
+    spte->cow = false;
+    lock_release (&frame_table_lock);
+    return false;
+  }
+  fte = frame_slot (spte->kpage);
+  if (!unshare_locked (fte, spte, kpage))
+  {
+    fte->pin_cnt++;
+    free_frame_with_lock (kpage);
+    palloc_free_page (kpage);
+  }
+  lock_release (&frame_table_lock);
+  return true;
+}
+
 /*
  * Free a frame table entry from kpage.
  * kpage must be kernel virtual address.
@@ -137,64 +819,300 @@ void
 free_frame_with_lock (void *kpage)
 {
   ASSERT (lock_held_by_current_thread(&frame_table_lock));
-  struct frame_table_entry *fte;
-  struct frame_table_entry *tmp_fte;
+  struct frame_table_entry *fte = frame_slot (kpage);
 
-  // TODO: Check if kpage valid ?
-  tmp_fte = (struct frame_table_entry *) malloc (sizeof (struct frame_table_entry));
+  ASSERT (fte->kpage != NULL);
+  if (fte->inode != NULL)
+  {
+    hash_delete (&page_cache, &fte->cache_elem);
+    fte->inode = NULL;
+  }
+  used_cnt--;
+  fte->kpage = NULL;
+  fte->owner = NULL;
+  fte->spte = NULL;
+  fte->pin_cnt = 0;
+  fte->refcnt = 0;
+}
 
-  tmp_fte->frame = (void *) vtop (kpage);
-  struct hash_elem *h_elem = hash_find (&frame_table, &tmp_fte->h_elem);
-  free (tmp_fte);
-  if (h_elem == NULL) {
-    // TODO: Frame not found!? handle it
-//    PANIC ("Can not find hash_elem\n");
-    return;
+/*
+ * Map the page cache's frame for spte's file page into spte's
+ * process, read-only.  Returns the frame, or a null pointer if
+ * the page is not cached.
+ */
+void *
+frame_cache_map (struct sup_page_table_entry *spte)
+{
+  struct frame_table_entry key;
+  struct hash_elem *e;
+  void *kpage = NULL;
+
+  key.inode = file_get_inode (spte->file);
+  key.ofs = spte->file_offset;
+  key.read_bytes = spte->file_page_read_bytes;
+
+  lock_acquire (&frame_table_lock);
+  e = hash_find (&page_cache, &key.cache_elem);
+  if (e != NULL)
+  {
+    struct frame_table_entry *fte
+      = hash_entry (e, struct frame_table_entry, cache_elem);
+    if (!fte->evicting
+        && pagedir_set_page (spte->owner->pagedir, spte->upage, fte->kpage,
+                             false))
+    {
+      kpage = fte->kpage;
+      spte->kpage = kpage;
+      spte->on_frame = true;
+      spte->access_time = timer_ticks ();
+      list_push_back (&fte->sharers, &spte->frame_elem);
+      fte->refcnt++;
+    }
   }
+  lock_release (&frame_table_lock);
+  return kpage;
+}
+
+/*
+ * Enter the frame at kpage, just loaded from its spte's file, in
+ * the page cache, unless another process got there first.
+ */
+void
+frame_cache_add (void *kpage)
+{
+  struct frame_table_entry *fte = get_frame_table_entry (kpage);
 
-  fte = hash_entry (h_elem, struct frame_table_entry, h_elem);
-  hash_delete (&frame_table, &fte->h_elem);
-//  pagedir_clear_page (fte->owner->pagedir, fte->upage);
-//  palloc_free_page (fte->kpage);
-  free (fte);
+  lock_acquire (&frame_table_lock);
+  ASSERT (fte->spte != NULL && !fte->spte->writable);
+  fte->inode = file_get_inode (fte->spte->file);
+  fte->ofs = fte->spte->file_offset;
+  fte->read_bytes = fte->spte->file_page_read_bytes;
+  if (hash_insert (&page_cache, &fte->cache_elem) != NULL)
+    fte->inode = NULL;
+  lock_release (&frame_table_lock);
 }
 
-void *
-select_victim_frame (void)
+/*
+ * Select the page replacement policy named NAME.
+ * Returns false if there is no such policy.
+ */
+bool
+frame_set_policy (const char *name)
 {
-  static size_t victim_index = 0;
-  size_t n;
-  struct hash_iterator it;
   size_t i;
 
-  n = hash_size (&frame_table);
+  for (i = 0; i < sizeof policy_names / sizeof *policy_names; i++)
+    if (!strcmp (name, policy_names[i]))
+    {
+      policy = i;
+      return true;
+    }
+  return false;
+}
 
-  hash_first (&it, &frame_table);
-  for(i = 0; i <= victim_index % n; ++i)
-    hash_next (&it);
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %lld evictions (%s)\n", evict_cnt, policy_names[policy]);
+}
 
-  do {
-    struct frame_table_entry *fte = hash_entry (hash_cur (&it), struct frame_table_entry, h_elem);
-    victim_index = (victim_index + 1) % n;
-    if(fte->pinned) continue;
-    if(!pagedir_is_accessed (fte->owner->pagedir, fte->upage)) {
-      return fte;
+/* Returns true if FTE holds a page that may be evicted.  Shared
+   frames, copy-on-write or in the page cache, are unmapped from
+   all their sharers. */
+static bool
+evictable (const struct frame_table_entry *fte)
+{
+  return (fte->kpage != NULL && fte->pin_cnt == 0 && !fte->evicting
+          && fte->spte != NULL);
+}
+
+/* Reads and clears the accessed bits of FTE's page in every
+   process that maps it. */
+static bool
+test_and_clear_accessed (struct frame_table_entry *fte)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct sup_page_table_entry *spte
+      = list_entry (e, struct sup_page_table_entry, frame_elem);
+    uint32_t *pd = spte->owner->pagedir;
+
+    if (pagedir_is_accessed (pd, spte->upage))
+    {
+      pagedir_set_accessed (pd, spte->upage, false);
+      accessed = true;
     }
-    pagedir_set_accessed (fte->owner->pagedir, fte->upage, false);
-  } while (hash_next (&it));
+  }
+  return accessed;
+}
 
-  hash_first (&it, &frame_table);
-  hash_next (&it);
+/* Returns true if any process that maps FTE's page has accessed
+   it, leaving the accessed bits alone. */
+static bool
+is_accessed (struct frame_table_entry *fte)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct sup_page_table_entry *spte
+      = list_entry (e, struct sup_page_table_entry, frame_elem);
+
+    if (pagedir_is_accessed (spte->owner->pagedir, spte->upage))
+      return true;
+  }
+  return false;
+}
 
-  do {
-    struct frame_table_entry *fte = hash_entry(hash_cur (&it), struct frame_table_entry, h_elem);
-    victim_index = (victim_index + 1) % n;
-        if(fte->pinned) continue;
-    if(!pagedir_is_accessed (fte->owner->pagedir, fte->upage)) {
+/* Returns the frame that follows the clock hand, and advances
+   the hand. */
+static struct frame_table_entry *
+advance_hand (void)
+{
+  struct frame_table_entry *fte = &frame_table[clock_hand];
+
+  clock_hand = (clock_hand + 1) % frame_cnt;
+  return fte;
+}
+
+/*
+ * Clock: sweep the frame table like a clock hand, starting where
+ * the last sweep stopped, and take the first frame whose accessed
+ * bit is clear, clearing accessed bits on the way.
+ */
+static struct frame_table_entry *
+select_clock (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * frame_cnt; i++)
+  {
+    struct frame_table_entry *fte = advance_hand ();
+    if (evictable (fte) && !test_and_clear_accessed (fte))
       return fte;
-    }
-    pagedir_set_accessed (fte->owner->pagedir, fte->upage, false);
-  } while (hash_next(&it));
+  }
+  return NULL;
+}
+
+/*
+ * Two-handed clock: the front hand clears accessed bits and the
+ * back hand, CLOCK2_SPREAD frames behind, takes the first frame
+ * not referenced again since the front hand passed it.  The
+ * spread, not the size of memory, bounds how long a page has to
+ * prove itself.
+ */
+static struct frame_table_entry *
+select_clock2 (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * frame_cnt; i++)
+  {
+    struct frame_table_entry *front
+      = &frame_table[(clock_hand + CLOCK2_SPREAD) % frame_cnt];
+    struct frame_table_entry *back = advance_hand ();
+
+    if (evictable (front))
+      test_and_clear_accessed (front);
+    if (evictable (back) && !is_accessed (back))
+      return back;
+  }
+  return NULL;
+}
+
+/*
+ * Aging: on every eviction, shift each frame's age right and put
+ * its accessed bit in the top bit, then take the frame with the
+ * smallest age.  Ties go to the first frame after the hand.
+ */
+static struct frame_table_entry *
+select_aging (void)
+{
+  struct frame_table_entry *victim = NULL;
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+  {
+    struct frame_table_entry *fte = advance_hand ();
+    if (!evictable (fte))
+      continue;
+    fte->age >>= 1;
+    if (test_and_clear_accessed (fte))
+      fte->age |= 0x80;
+    if (victim == NULL || fte->age < victim->age)
+      victim = fte;
+  }
+  return victim;
+}
+
+/*
+ * Approximate LRU: stamp each page found accessed with the
+ * current time, then take the page with the oldest stamp.
+ */
+static struct frame_table_entry *
+select_lru (void)
+{
+  struct frame_table_entry *victim = NULL;
+  int64_t now = timer_ticks ();
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+  {
+    struct frame_table_entry *fte = advance_hand ();
+    if (!evictable (fte))
+      continue;
+    if (test_and_clear_accessed (fte))
+      fte->spte->access_time = now;
+    if (victim == NULL || fte->spte->access_time < victim->spte->access_time)
+      victim = fte;
+  }
+  return victim;
+}
+
+/*
+ * Choose a frame to evict, by the policy selected at boot.
+ * Returns a null pointer if no frame can be evicted.
+ */
+static struct frame_table_entry *
+choose_victim (void)
+{
+  struct frame_table_entry *victim = NULL;
+
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
 
-  PANIC("Can not reach here. Select_victim_frame");
-}
\ No newline at end of file
+  switch (policy)
+  {
+    case EVICT_CLOCK:
+      victim = select_clock ();
+      break;
+    case EVICT_CLOCK2:
+      victim = select_clock2 ();
+      break;
+    case EVICT_AGING:
+      victim = select_aging ();
+      break;
+    case EVICT_LRU:
+      victim = select_lru ();
+      break;
+  }
+  return victim;
+}
+
+/*
+ * Choose a frame to evict, by the policy selected at boot.
+ * Must acquire frame_table_lock beforehand.
+ */
+void *
+select_victim_frame (void)
+{
+  struct frame_table_entry *victim = choose_victim ();
+
+  if (victim == NULL)
+    PANIC ("Can not reach here. Select_victim_frame");
+  return victim;
+}
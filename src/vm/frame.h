@@ -1,29 +1,60 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <hash.h>
+#include "filesys/off_t.h"
 #include "vm/page.h"
 
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
+/* One entry per page in the user pool, indexed by its page
+   number within the pool.  KPAGE is null while the page is not
+   allocated.  After fork() several processes may map the frame,
+   copy-on-write; SHARERS lists their supplemental page table
+   entries, and OWNER, UPAGE and SPTE describe one of them.
+   A clean, read-only file page is also entered in the page
+   cache under (INODE, OFS, READ_BYTES), so that every process
+   mapping that page of the file shares the frame. */
 struct frame_table_entry
 {
-	uint32_t* frame;
 	struct thread* owner;
 	struct sup_page_table_entry* spte;
-	struct hash_elem h_elem;
 	void *kpage; // Save kernel virtual page address TODO: others use uint8_t as type, why??
 	void *upage;
-	bool pinned;
+	int pin_cnt;            /* Pins held; not evicted while nonzero. */
+	bool evicting;          /* Being paged out by the daemon. */
+	uint8_t age;            /* Reference history, for aging. */
+	int refcnt;             /* Number of entries in SHARERS. */
+	struct list sharers;    /* sup_page_table_entry frame_elems. */
+	struct inode *inode;    /* Cached file page's inode, or NULL. */
+	off_t ofs;              /* Cached file page's offset. */
+	uint32_t read_bytes;    /* Bytes read from the file; rest is zero. */
+	struct hash_elem cache_elem; /* In the page cache. */
 };
 
 void frame_init (void);
 struct frame_table_entry* get_frame_table_entry (void *kpage);
 void * allocate_frame_and_pin (enum palloc_flags flags, void *upage, bool pinned);
+size_t allocate_frames_and_pin (enum palloc_flags flags, void *upages[],
+                                void *kpages[], size_t cnt);
 void * allocate_frame (enum palloc_flags flags, void *upage);
+bool frame_has_spare (void);
 void fte_update_pinned (void *kpage, bool pinned);
+bool frame_pin (struct sup_page_table_entry *spte);
+size_t frame_pin_batch (struct sup_page_table_entry *sptes[], size_t cnt);
+void frame_unpin_batch (struct sup_page_table_entry *sptes[], size_t cnt);
 void fte_install_spte (void *kpage, struct sup_page_table_entry *spte);
 void free_frame_with_lock (void *kpage);
 void free_frame (void *addr);
+bool frame_share (struct sup_page_table_entry *spte,
+                  struct sup_page_table_entry *new_spte);
+bool frame_unshare (struct sup_page_table_entry *spte);
+bool frame_unshare_into (struct sup_page_table_entry *spte, void *kpage);
+void *frame_cache_map (struct sup_page_table_entry *spte);
+void frame_cache_add (void *kpage);
 void * select_victim_frame (void);
+bool frame_set_policy (const char *name);
+void frame_start_pageout (void);
+void frame_wait_pageout (void *kpage);
+void frame_print_stats (void);
 #endif /* vm/frame.h */
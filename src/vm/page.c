@@ -1,14 +1,22 @@
 #include <lib/kernel/hash.h>
 #include <filesys/file.h>
+#include <round.h>
 #include <string.h>
 #include "userprog/syscall.h"
 #include "userprog/pagedir.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "filesys/inode.h"
 #include "filesys/off_t.h"
 #include "vm/page.h"
 #include "vm/frame.h"
 
+/* A page of zeros.  Reads of an ALL_ZERO page that has never
+   been written map this page read-only instead of taking a frame;
+   the first write gets the page a frame of its own. */
+static void *zero_page;
+
 static unsigned
 spte_hash_func(const struct hash_elem *elem, void *aux UNUSED)
 {
@@ -28,14 +36,23 @@ static void
 spte_destroy_func(struct hash_elem *elem, void *aux UNUSED)
 {
   struct sup_page_table_entry *entry = hash_entry(elem, struct sup_page_table_entry, h_elem);
-  if (entry->on_frame) {
+  /* free_frame() may wait for the page-out daemon, which moves
+     the page to swap. */
+  if (entry->zero_mapped)
+    pagedir_clear_page (entry->owner->pagedir, entry->upage);
+  if (entry->on_frame)
     free_frame (entry->kpage);
-  } else if (entry->source == SWAP) {
+  if (!entry->on_frame && entry->source == SWAP)
     free_swap_slot (entry->swap_index);
-  }
   free (entry);
 }
 
+void
+sup_page_init (void)
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
 struct hash *
 sup_page_create (void)
 {
@@ -62,90 +79,298 @@ sup_page_table_get_entry (struct hash *sup_page_table, void *upage)
   return hash_entry (elem, struct sup_page_table_entry, h_elem);
 }
 
+/* Returns the index of the first of VT's VMAs that ends above
+   ADDR, or VT->cnt if there is none. */
+static size_t
+vma_search (const struct vma_table *vt, const void *addr)
+{
+  size_t lo = 0, hi = vt->cnt;
+
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (vt->vmas[mid].end <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Returns the VMA of T that contains UPAGE, or NULL. */
+static struct vma *
+vma_find (struct thread *t, const void *upage)
+{
+  struct vma_table *vt = &t->vmas;
+  size_t i = vma_search (vt, upage);
+
+  if (i < vt->cnt && vt->vmas[i].start <= upage)
+    return &vt->vmas[i];
+  return NULL;
+}
+
+/* Adds a copy of VMA to T's table, which must not have one that
+   overlaps it.  Returns false if memory runs out. */
+static bool
+vma_insert (struct thread *t, const struct vma *vma)
+{
+  struct vma_table *vt = &t->vmas;
+  size_t i;
+
+  if (vt->cnt == vt->cap)
+  {
+    size_t cap = vt->cap > 0 ? vt->cap * 2 : 4;
+    struct vma *vmas = realloc (vt->vmas, cap * sizeof *vmas);
+    if (vmas == NULL)
+      return false;
+    vt->vmas = vmas;
+    vt->cap = cap;
+  }
+  i = vma_search (vt, vma->start);
+  memmove (&vt->vmas[i + 1], &vt->vmas[i], (vt->cnt - i) * sizeof *vma);
+  vt->vmas[i] = *vma;
+  vt->cnt++;
+  return true;
+}
+
 bool
 sup_page_table_has_entry (struct hash *sup_page_table, void *vaddr)
 {
   struct sup_page_table_entry *spte = sup_page_table_get_entry (sup_page_table, vaddr);
-  if(spte == NULL) return false;
+  if(spte == NULL)
+    return vma_find (thread_current (), vaddr) != NULL;
   return true;
 }
 
-bool
-sup_page_install_zero_page (void *upage)
+/* Adds an entry for UPAGE to the current process's table, with
+   nothing in it yet.  Returns NULL if there already is one or
+   memory runs out. */
+static struct sup_page_table_entry *
+new_spte (void *upage, bool writable)
 {
   struct hash *spt = thread_current ()->spt;
   struct sup_page_table_entry *spte = malloc (sizeof (struct sup_page_table_entry));
 
+  if (spte == NULL)
+    return NULL;
   spte->upage = upage;
   spte->kpage = NULL;
+  spte->owner = thread_current ();
   spte->on_frame = false;
-  spte->writable = true;
+  spte->writable = writable;
+  spte->cow = false;
+  spte->zero_mapped = false;
   spte->dirty = false;
   spte->accessed = false;
   // TODO: Accessed
   spte->source = ALL_ZERO;
+  spte->file = NULL;
 
-  struct hash_elem *prev_elem;
-  prev_elem = hash_insert (spt, &spte->h_elem);
-  if (prev_elem != NULL) {
+  if (hash_insert (spt, &spte->h_elem) != NULL) {
+    free (spte);
+    return NULL;
+  }
+  return spte;
+}
+
+bool
+sup_page_install_zero_page (void *upage)
+{
+  if (new_spte (upage, true) == NULL) {
     // TODO: Unexpected dup entry? Need validation?
     printf ("Duplicate entry when installing zero page\n");
-    free (spte);
     return false;
   }
   return true;
 }
 
 /*
- * Save what to do later on spt (Installing page with source FILE_SYS)
- * Later, allocate user frame, read file, install page
+ * Returns the current process's entry for upage, making one if
+ * upage lies in a reserved range but has not been accessed yet.
+ * Returns NULL if upage is not part of the address space.
+ */
+static struct sup_page_table_entry *
+get_page (void *upage)
+{
+  struct thread *cur = thread_current ();
+  struct sup_page_table_entry *spte;
+  struct vma *vma;
+  size_t page_ofs;
+
+  spte = sup_page_table_get_entry (cur->spt, upage);
+  if (spte != NULL)
+    return spte;
+  vma = vma_find (cur, upage);
+  if (vma == NULL)
+    return NULL;
+
+  spte = new_spte (upage, vma->writable);
+  if (spte == NULL)
+    return NULL;
+  page_ofs = (uint8_t *) upage - (uint8_t *) vma->start;
+  if (vma->read_bytes > page_ofs)
+  {
+    uint32_t read_bytes = vma->read_bytes - page_ofs;
+    if (read_bytes > PGSIZE)
+      read_bytes = PGSIZE;
+    spte->source = FILE_SYS;
+    spte->file = vma->file;
+    spte->file_offset = vma->offset + page_ofs;
+    spte->file_page_read_bytes = read_bytes;
+    spte->file_page_zero_bytes = PGSIZE - read_bytes;
+  }
+  return spte;
+}
+
+/*
+ * Reserve SIZE bytes at START, a page boundary, rounded up to whole
+ * pages.  The first READ_BYTES of them are read from FILE
+ * starting at OFFSET on first access, and the rest are zeros.
+ * Takes time in the lesser of the range's pages and the process's
+ * page table entries, not SIZE.  Returns false if the range
+ * overlaps pages already in the address space or memory runs out.
  */
 bool
-sup_page_reserve_segment (void *upage, struct file * file, off_t offset, uint32_t page_read_bytes, uint32_t page_zero_bytes, bool writable)
+sup_page_reserve_range (void *start, size_t size, struct file *file,
+                        off_t offset, uint32_t read_bytes, bool writable)
 {
-  struct hash *spt = thread_current ()->spt;
-  struct sup_page_table_entry *spte = malloc (sizeof (struct sup_page_table_entry));
-  spte->upage = upage;
-  spte->kpage = NULL;
-  spte->on_frame = false;
-  spte->dirty = false;
-  spte->accessed = false;
-  // TODO: Access time
-
-//  printf("Reserve segment %x %x\n", (int *)upage, (int *) offset);
-  spte->source = FILE_SYS;
-  spte->file = file;
-  spte->file_offset = offset;
-  spte->file_page_read_bytes = page_read_bytes;
-  spte->file_page_zero_bytes = page_zero_bytes;
-  spte->writable = writable;
+  struct thread *cur = thread_current ();
+  struct vma vma;
+  uint8_t *upage;
+  size_t idx;
+
+  ASSERT (pg_ofs (start) == 0);
+  ASSERT (read_bytes <= size);
+
+  vma.start = start;
+  vma.end = (uint8_t *) start + ROUND_UP (size, PGSIZE);
+  vma.file = file;
+  vma.offset = offset;
+  vma.read_bytes = read_bytes;
+  vma.writable = writable;
+  if (size == 0 || vma.end > PHYS_BASE || vma.end < vma.start)
+    return false;
 
-  struct hash_elem *prev_elem;
-  prev_elem = hash_insert (spt, &spte->h_elem);
-  if (prev_elem == NULL) return true;
-  // TODO: Unexpected dup entry? Need validation?
-  printf ("Duplicate entry when reserving new segment from file\n");
-  free (spte);
-  return false;
+  idx = vma_search (&cur->vmas, start);
+  if (idx < cur->vmas.cnt && cur->vmas.vmas[idx].start < vma.end)
+    return false;
+
+  /* Pages outside any range (stack, writable segments) have only
+     SPT entries.  Look up the range's own pages, or for a range
+     larger than the SPT, check the entries instead. */
+  if ((size_t) ((uint8_t *) vma.end - (uint8_t *) vma.start) / PGSIZE
+      <= hash_size (cur->spt))
+  {
+    for (upage = vma.start; upage < (uint8_t *) vma.end; upage += PGSIZE)
+      if (sup_page_table_get_entry (cur->spt, upage) != NULL)
+        return false;
+  }
+  else
+  {
+    struct hash_iterator i;
+
+    hash_first (&i, cur->spt);
+    while (hash_next (&i))
+    {
+      struct sup_page_table_entry *spte
+        = hash_entry (hash_cur (&i), struct sup_page_table_entry, h_elem);
+      if ((void *) spte->upage >= vma.start && (void *) spte->upage < vma.end)
+        return false;
+    }
+  }
+  return vma_insert (cur, &vma);
+}
+
+/* Forget the range reserved at START.  Its pages must have been
+   unmapped already. */
+void
+sup_page_release_range (void *start)
+{
+  struct vma_table *vt = &thread_current ()->vmas;
+  struct vma *vma = vma_find (thread_current (), start);
+  size_t i;
+
+  if (vma == NULL || vma->start != start)
+    return;
+  i = vma - vt->vmas;
+  memmove (vma, vma + 1, (vt->cnt - i - 1) * sizeof *vma);
+  vt->cnt--;
+}
+
+/* Forget all of the current process's ranges. */
+void
+sup_page_destroy_ranges (void)
+{
+  struct vma_table *vt = &thread_current ()->vmas;
+
+  free (vt->vmas);
+  vt->vmas = NULL;
+  vt->cnt = vt->cap = 0;
 }
 
 static bool
 load_from_filesys (struct sup_page_table_entry *spte, void *kpage)
 {
-  struct file *file = spte->file;
   uint32_t page_read_bytes = spte->file_page_read_bytes;
   uint32_t page_zero_bytes = spte->file_page_zero_bytes;
-  off_t ofs = spte->file_offset;
 
-  sema_down_filesys ();
-  file_seek (file, ofs);
+  /* The frame is the only copy of the page that stays in memory:
+     its sectors are not also kept in the buffer cache.  Reading
+     at an explicit offset leaves the file's position alone, so
+     the file system lock is not needed. */
+  if (inode_read_direct (file_get_inode (spte->file), kpage,
+                         page_read_bytes, spte->file_offset)
+      != (int) page_read_bytes)
+    return false;
+  memset (kpage + page_read_bytes, 0, page_zero_bytes);
+  return true;
+}
+
+/*
+ * Read spte's page into kpage, a zeroed frame allocated for it,
+ * and map it.  Frees the frame and returns false on failure.
+ */
+static bool
+load_into_frame (struct sup_page_table_entry *spte, void *kpage)
+{
+  uint32_t *pagedir = thread_current ()->pagedir;
+  bool cacheable = spte->source == FILE_SYS && !spte->writable;
 
-  if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+  switch (spte->source)
   {
+    case FILE_SYS:
+      if (!load_from_filesys (spte, kpage))
+      {
+        printf("Load from filesys fail\n");
+        free_frame (kpage);
+        return false;
+      }
+      break;
+    case SWAP:
+      swap_in (spte->swap_index, kpage);
+      break;
+    case ALL_ZERO:
+      // Nothing to do
+      break;
+    default:
+      printf ("Unknown SPTE source %d\n", spte->source);
+      return false;
+  }
+
+  if (!pagedir_set_page (pagedir, spte->upage, kpage, spte->writable))
+  {
+    free_frame (kpage);
     return false;
   }
-  sema_up_filesys ();
-  memset (kpage + page_read_bytes, 0, page_zero_bytes);
+
+  // Success!
+  spte->on_frame = true;
+  spte->kpage = kpage;
+  spte->cow = false;
+  fte_install_spte (kpage, spte);
+  if (cacheable)
+    frame_cache_add (kpage);
+
   return true;
 }
 
@@ -164,12 +389,11 @@ sup_page_load_page_and_pin (void *upage, bool pinned, bool create_new)
 {
   struct thread *cur = thread_current ();
   uint32_t *pagedir = cur->pagedir;
-  struct hash *spt = cur->spt;
   struct sup_page_table_entry *spte;
   void *kpage;
-  bool writable;
+  bool writable, cacheable;
 
-  spte = sup_page_table_get_entry (spt, upage);
+  spte = get_page (upage);
 
   if(spte == NULL) {
     if (create_new) {
@@ -180,56 +404,265 @@ sup_page_load_page_and_pin (void *upage, bool pinned, bool create_new)
   }
 
   writable = spte->writable;
+  if (spte->zero_mapped) {
+    pagedir_clear_page (pagedir, upage);
+    spte->zero_mapped = false;
+  }
   if(spte->on_frame) {
-    fte_update_pinned (spte->kpage, pinned);
-//    printf ("Dup load request.\n");
+    // Unmapped but still on a frame: being paged out
+    if (pagedir_get_page (pagedir, upage) == NULL)
+      frame_wait_pageout (spte->kpage);
+  }
+  /* The kernel reaches pinned pages through their frames, so
+     they must not be shared. */
+  if(spte->on_frame && spte->cow && pinned) {
+    if (!frame_unshare (spte))
+      return false;
+  }
+  /* Already in memory, unless it was paged out meanwhile. */
+  if(spte->on_frame && (!pinned || frame_pin (spte)))
     return true;
+
+  /* Read-only file pages are shared through the page cache. */
+  cacheable = spte->source == FILE_SYS && !writable;
+  if (cacheable) {
+    kpage = frame_cache_map (spte);
+    if (kpage != NULL) {
+      spte->cow = false;
+      if (pinned)
+        fte_update_pinned (kpage, true);
+      return true;
+    }
   }
 
   kpage = allocate_frame_and_pin (PAL_USER | PAL_ZERO, upage, pinned);
 
   if (kpage == NULL)
     return false;
+  return load_into_frame (spte, kpage);
+}
 
-  switch (spte->source)
+/*
+ * Fault-around: a fault on a page of a file also loads the other
+ * not yet loaded pages of the same file in the aligned window of
+ * FAULT_AROUND pages around it, so that programs starting up and
+ * scans of mapped files take one fault per window, not per page.
+ * Pages are only loaded ahead while frames are plentiful, and
+ * pages not accessed yet only if their range maps the same file.
+ */
+static int fault_around = 8;
+
+/*
+ * Set the fault-around window to PAGES pages; 1 turns it off.
+ * Returns false if PAGES is out of range.
+ */
+bool
+sup_page_set_fault_around (int pages)
+{
+  if (pages < 1 || pages > 64)
+    return false;
+  fault_around = pages;
+  return true;
+}
+
+static void
+load_around (struct sup_page_table_entry *spte)
+{
+  struct thread *cur = thread_current ();
+  uintptr_t page_no = pg_no (spte->upage);
+  uintptr_t first = page_no - page_no % fault_around;
+  uintptr_t i;
+
+  for (i = first; i < first + fault_around; i++)
   {
-    case FILE_SYS:
-      if (!load_from_filesys (spte, kpage))
-      {
-        printf("Load from filesys fail\n");
-        free_frame (kpage);
-        return false;
-      }
-      break;
-    case SWAP:
-      swap_in (spte->swap_index, kpage);
-      break;
-    case ALL_ZERO:
-      // Nothing to do
+    void *upage = (void *) (i << PGBITS);
+    struct sup_page_table_entry *near;
+    struct vma *vma;
+
+    if (i == page_no || !is_user_vaddr (upage))
+      continue;
+    if (!frame_has_spare ())
       break;
-    default:
-      printf ("Unknown SPTE source %d\n", spte->source);
-      return false;
+    near = sup_page_table_get_entry (cur->spt, upage);
+    if (near == NULL)
+    {
+      vma = vma_find (cur, upage);
+      if (vma == NULL || vma->file != spte->file)
+        continue;
+      near = get_page (upage);
+    }
+    if (near == NULL || near->on_frame || near->source != FILE_SYS
+        || near->file != spte->file || near->writable != spte->writable)
+      continue;
+    sup_page_load_page_and_pin (upage, false, false);
   }
+}
+
+bool
+sup_page_load_page (void *upage)
+{
+  struct sup_page_table_entry *spte;
+  bool from_file;
 
-  if (!pagedir_set_page (pagedir, upage, kpage, writable))
+  spte = get_page (upage);
+  from_file = spte != NULL && !spte->on_frame && spte->source == FILE_SYS;
+  if (!sup_page_load_page_and_pin (upage, false, false))
+    return false;
+  if (from_file && fault_around > 1)
+    load_around (spte);
+  return true;
+}
+
+/*
+ * Handle a read fault on upage by mapping the zero page, if upage
+ * is an ALL_ZERO page not in memory.  Returns false if the page
+ * has to be loaded instead.
+ */
+bool
+sup_page_map_zero (void *upage)
+{
+  struct thread *cur = thread_current ();
+  struct sup_page_table_entry *spte;
+
+  spte = get_page (upage);
+  if (spte == NULL || spte->on_frame || spte->source != ALL_ZERO)
+    return false;
+  if (!pagedir_set_page (cur->pagedir, upage, zero_page, false))
+    return false;
+  spte->zero_mapped = true;
+  return true;
+}
+
+/* Number of pages sup_page_pin_range() and
+   sup_page_unpin_range() hand to the frame table at once. */
+#define PIN_BATCH 32
+
+/*
+ * Make spte's page resident and pinned in a frame of its own.
+ * kpage is a pinned frame allocated for it by
+ * allocate_frames_and_pin(); it is released if the page turns out
+ * not to need it.  Returns false if the page cannot be loaded.
+ */
+static bool
+pin_into_frame (struct sup_page_table_entry *spte, void *kpage)
+{
+  if (spte->cow && frame_unshare_into (spte, kpage))
+    return true;
+
+  /* Read-only file pages are shared through the page cache. */
+  if (spte->source == FILE_SYS && !spte->writable
+      && frame_cache_map (spte) != NULL)
   {
+    spte->cow = false;
+    fte_update_pinned (spte->kpage, true);
     free_frame (kpage);
-    return false;
+    palloc_free_page (kpage);
+    return true;
   }
+  return load_into_frame (spte, kpage);
+}
 
-  // Success!
-  spte->on_frame = true;
-  spte->kpage = kpage;
-  fte_install_spte (kpage, spte);
+/*
+ * Load and pin the pages holding the LEN bytes at BUFFER, so that
+ * the kernel can reach them through their frames, making zero
+ * pages where there are none.  Pages are taken PIN_BATCH at a
+ * time: those in memory are pinned under one acquisition of the
+ * frame table lock, frames for the rest and for copies of
+ * copy-on-write pages are allocated under another, and then the
+ * pages are read in back to back.  Pins nest: each call must be
+ * matched by sup_page_unpin_range().
+ * Returns false, with nothing pinned, if a page cannot be loaded.
+ */
+bool
+sup_page_pin_range (const void *buffer, size_t len)
+{
+  struct thread *cur = thread_current ();
+  struct sup_page_table_entry *sptes[PIN_BATCH], *batch[PIN_BATCH];
+  bool cow[PIN_BATCH];
+  size_t need[PIN_BATCH];
+  void *upages[PIN_BATCH], *kpages[PIN_BATCH];
+  uint8_t *start = pg_round_down (buffer);
+  uint8_t *upage = start;
+  uint8_t *end = (uint8_t *) buffer + len;
+
+  while (upage < end)
+  {
+    uint8_t *first = upage;
+    size_t n, m, got, i, j;
+
+    for (n = 0; n < PIN_BATCH && upage < end; n++, upage += PGSIZE)
+    {
+      struct sup_page_table_entry *spte = get_page (upage);
+
+      if (spte == NULL && sup_page_install_zero_page (upage))
+        spte = sup_page_table_get_entry (cur->spt, upage);
+      if (spte == NULL)
+      {
+        sup_page_unpin_range (start, first - start);
+        return false;
+      }
+      if (spte->zero_mapped)
+      {
+        pagedir_clear_page (cur->pagedir, upage);
+        spte->zero_mapped = false;
+      }
+      /* Copy-on-write pages need a frame of their own first. */
+      sptes[n] = spte;
+      cow[n] = spte->cow;
+      batch[n] = cow[n] ? NULL : spte;
+    }
 
+    /* Pages left in BATCH are not in memory. */
+    frame_pin_batch (batch, n);
+    for (m = i = 0; i < n; i++)
+      if (cow[i] || batch[i] != NULL)
+      {
+        need[m] = i;
+        upages[m++] = first + i * PGSIZE;
+      }
+
+    got = allocate_frames_and_pin (PAL_USER | PAL_ZERO, upages, kpages, m);
+    for (i = 0; i < m; i++)
+    {
+      if (i < got && pin_into_frame (sptes[need[i]], kpages[i]))
+        continue;
+
+      /* Undo the frames and pins taken so far. */
+      for (j = i + 1; j < got; j++)
+      {
+        free_frame (kpages[j]);
+        palloc_free_page (kpages[j]);
+      }
+      for (j = i; j < m; j++)
+        sptes[need[j]] = NULL;
+      frame_unpin_batch (sptes, n);
+      sup_page_unpin_range (start, first - start);
+      return false;
+    }
+  }
   return true;
 }
 
-bool
-sup_page_load_page (void *upage)
+/*
+ * Unpin the pages holding the LEN bytes at BUFFER, pinned by
+ * sup_page_pin_range().
+ */
+void
+sup_page_unpin_range (const void *buffer, size_t len)
 {
-  return sup_page_load_page_and_pin (upage, false, false);
+  struct thread *cur = thread_current ();
+  struct sup_page_table_entry *batch[PIN_BATCH];
+  uint8_t *upage = pg_round_down (buffer);
+  uint8_t *end = (uint8_t *) buffer + len;
+
+  while (upage < end)
+  {
+    size_t n;
+
+    for (n = 0; n < PIN_BATCH && upage < end; n++, upage += PGSIZE)
+      batch[n] = sup_page_table_get_entry (cur->spt, upage);
+    frame_unpin_batch (batch, n);
+  }
 }
 
 bool
@@ -251,14 +684,18 @@ sup_page_update_frame_pinned (void *upage, bool pinned)
 
 // TODO: Not sure about this function..
 bool
-sup_page_install_frame (struct hash *sup_page_table, void *upage, void *kpage)
+sup_page_install_frame (struct hash *sup_page_table, void *upage, void *kpage, bool writable)
 {
   struct sup_page_table_entry *spte;
 
   spte = malloc (sizeof (struct sup_page_table_entry));
   spte->upage = upage;
   spte->kpage = kpage;
-  spte->writable = true; // TODO: Hmm..
+  spte->owner = thread_current ();
+  spte->writable = writable;
+  spte->cow = false;
+  spte->zero_mapped = false;
+  spte->file = NULL;
 
   spte->on_frame = true;
   spte->dirty = false;
@@ -278,39 +715,201 @@ sup_page_install_frame (struct hash *sup_page_table, void *upage, void *kpage)
   }
 }
 
-void sup_page_unmap(void* upage, int size, off_t file_ofs){
-  struct thread *t = thread_current();
-  struct sup_page_table_entry * spte = sup_page_table_get_entry(t->spt, upage);
-  if (spte == NULL){
-    printf("PANIC sup_page_unmap no such spte!\n");
+/*
+ * Write upage, a page of a memory-mapped file, back to the file if
+ * it is dirty.  Only the part of the page inside the file is
+ * written.  A page in swap is dirty, and is read back first.
+ * Must hold filesys_sema.
+ */
+void
+sup_page_write_back (void *upage)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct sup_page_table_entry *spte;
+
+  spte = sup_page_table_get_entry (thread_current ()->spt, upage);
+  if (spte == NULL)
+    return;
+  if (!frame_pin (spte))
+  {
+    /* Not in memory: clean in the file, or dirty in swap.  A
+       page in swap loads without the file system. */
+    if (spte->source != SWAP || !sup_page_load_page_and_pin (upage, true, false))
+      return;
+  }
+  if (pagedir_is_dirty (pd, upage) || spte->dirty)
+  {
+    file_write_at (spte->file, spte->kpage, spte->file_page_read_bytes,
+                   spte->file_offset);
+    pagedir_set_dirty (pd, upage, false);
+    spte->dirty = false;
+  }
+  fte_update_pinned (spte->kpage, false);
+}
+
+/*
+ * Unmap upage, a page of a memory-mapped file, writing it back
+ * first if it is dirty.  Must hold filesys_sema.
+ */
+void
+sup_page_unmap (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct sup_page_table_entry *spte = sup_page_table_get_entry (t->spt, upage);
+
+  if (spte == NULL)
     return;
+  sup_page_write_back (upage);
+  if (spte->on_frame)
+  {
+    void *kpage = spte->kpage;
+
+    pagedir_clear_page (t->pagedir, upage);
+    /* May wait for the page-out daemon, which then frees the
+       page itself. */
+    free_frame (kpage);
+    if (spte->on_frame)
+      palloc_free_page (kpage);
   }
-  //case on_frame dirty control이 있어야함,
-  // printf("case start :");
-  if(spte->on_frame){
-    // printf("case1\n");
-    bool dirty = pagedir_is_dirty(t->pagedir, upage) || spte->dirty;
-    if(dirty){
-      file_write_at(spte->file, spte->upage, size, file_ofs);
-    }
-    free_frame(spte->kpage);
-    pagedir_clear_page(t->pagedir, upage);
-  }else if(spte->source == SWAP){
-    // printf("case2\n");
-    bool dirty = pagedir_is_dirty(t->pagedir, upage) || spte->dirty;
-    if(dirty){
-      void * temp_page  = malloc(sizeof(upage));
-      swap_in(spte->swap_index, temp_page);
-      file_write_at(spte->file, temp_page, size, file_ofs);
-      free(temp_page);
-    }else{
-      free_swap_slot(spte->swap_index);
-    }
-  }else if(spte->source == FILE_SYS){
-    // printf("case3\n");
-  }else{
-    printf("PANIC. NO case remain\n");
+  if (!spte->on_frame && spte->source == SWAP)
+    free_swap_slot (spte->swap_index);
+  hash_delete (t->spt, &spte->h_elem);
+  free (spte);
+}
+
+/* Returns true if UPAGE lies in one of T's memory-mapped files. */
+static bool
+in_mmap (struct thread *t, void *upage)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&t->map_list); e != list_end (&t->map_list);
+       e = list_next (e))
+  {
+    struct map_desc *mdesc = list_entry (e, struct map_desc, elem);
+    if (upage >= mdesc->address && upage < mdesc->address + mdesc->size)
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Give child_spte the page that parent_spte describes.  A page in
+ * memory is shared, copy-on-write if writable, unless the kernel
+ * has it pinned; a page in swap is copied.  Returns false if
+ * memory runs out.
+ */
+static bool
+fork_page (struct sup_page_table_entry *parent_spte,
+           struct sup_page_table_entry *child_spte)
+{
+  uint32_t *pagedir = child_spte->owner->pagedir;
+  void *upage = child_spte->upage;
+  void *kpage;
+
+  if (!frame_share (parent_spte, child_spte))
+    return false;
+  if (child_spte->on_frame)
+    return pagedir_set_page (pagedir, upage, child_spte->kpage,
+                             child_spte->writable && !child_spte->cow);
+
+  if (parent_spte->source != SWAP)
+  {
+    child_spte->source = parent_spte->source;
+    return true;
+  }
+
+  kpage = allocate_frame_and_pin (PAL_USER, upage, true);
+  if (kpage == NULL)
+    return false;
+  swap_copy (parent_spte->swap_index, kpage);
+  if (!pagedir_set_page (pagedir, upage, kpage, child_spte->writable))
+  {
+    free_frame (kpage);
+    palloc_free_page (kpage);
+    return false;
   }
-  // 여기도 에러를 만든다 
-  hash_delete(t->spt,&spte->h_elem);
-}
\ No newline at end of file
+  child_spte->on_frame = true;
+  child_spte->kpage = kpage;
+  child_spte->dirty = true;
+  fte_install_spte (kpage, child_spte);
+  fte_update_pinned (kpage, false);
+  return true;
+}
+
+/*
+ * Copy parent's address space into the current process, for
+ * fork().  The current process must already have its page
+ * directory, supplemental page table and executable.  Memory
+ * mappings are not inherited.  Returns false if memory runs out;
+ * the caller then destroys what was copied so far.
+ */
+bool
+sup_page_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct hash_iterator i;
+  size_t v;
+
+  for (v = 0; v < parent->vmas.cnt; v++)
+  {
+    struct vma vma = parent->vmas.vmas[v];
+
+    if (in_mmap (parent, vma.start))
+      continue;
+    if (vma.file != NULL && vma.file == parent->executable)
+      vma.file = cur->executable;
+    if (!vma_insert (cur, &vma))
+      return false;
+  }
+
+  hash_first (&i, parent->spt);
+  while (hash_next (&i))
+  {
+    struct sup_page_table_entry *parent_spte
+      = hash_entry (hash_cur (&i), struct sup_page_table_entry, h_elem);
+    struct sup_page_table_entry *spte;
+
+    if (in_mmap (parent, parent_spte->upage))
+      continue;
+
+    spte = malloc (sizeof *spte);
+    if (spte == NULL)
+      return false;
+    *spte = *parent_spte;
+    spte->owner = cur;
+    spte->kpage = NULL;
+    spte->on_frame = false;
+    spte->cow = false;
+    spte->zero_mapped = false;
+    /* Must not claim the parent's swap slot, even if fork_page()
+       fails. */
+    spte->source = ALL_ZERO;
+    if (spte->file != NULL && spte->file == parent->executable)
+      spte->file = cur->executable;
+    hash_insert (cur->spt, &spte->h_elem);
+
+    if (!fork_page (parent_spte, spte))
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Handle a write fault on upage, which the current process may
+ * write but which is mapped read-only: shared copy-on-write, or
+ * mapped to the zero page.  Returns false if upage is not such a
+ * page or memory runs out.
+ */
+bool
+sup_page_write_fault (void *upage)
+{
+  struct sup_page_table_entry *spte;
+
+  spte = sup_page_table_get_entry (thread_current ()->spt, upage);
+  if (spte != NULL && spte->zero_mapped && spte->writable)
+    return sup_page_load_page (upage);
+  if (spte == NULL || !spte->cow)
+    return false;
+  return frame_unshare (spte);
+}
@@ -57,7 +57,12 @@ struct sup_page_table_entry
 
 	struct hash_elem h_elem;
 
+	struct thread *owner;       /* Process whose page this is. */
+	struct list_elem frame_elem; /* In frame's sharers list. */
+
   bool writable;
+	bool cow;                   /* Shared copy-on-write, mapped read-only. */
+	bool zero_mapped;           /* ALL_ZERO page mapped to the zero page. */
 
 	bool on_frame;
 	bool dirty;
@@ -76,21 +81,55 @@ struct sup_page_table_entry
   uint32_t file_page_read_bytes, file_page_zero_bytes;
 };
 
+/*
+ * A range of pages reserved as a whole, [START, END), by loading
+ * an executable or by mmap().  The first READ_BYTES bytes come
+ * from FILE starting at OFFSET and the rest are zeros; FILE is
+ * null for anonymous memory.  A page of the range gets a
+ * sup_page_table_entry only when it is first accessed.
+ */
+struct vma
+{
+  void *start, *end;
+  struct file *file;
+  off_t offset;
+  uint32_t read_bytes;
+  bool writable;
+};
+
+/* A process's VMAs, sorted by address and not overlapping. */
+struct vma_table
+{
+  struct vma *vmas;
+  size_t cnt, cap;
+};
+
+void sup_page_init (void);
 struct hash* sup_page_create (void);
 void sup_page_destroy (struct hash *sup_page_table);
 
-bool sup_page_install_frame (struct hash *sup_page_table, void *upage, void *kpage);
+bool sup_page_install_frame (struct hash *sup_page_table, void *upage, void *kpage, bool writable);
 struct sup_page_table_entry* sup_page_table_get_entry (struct hash *sup_page_table, void *upage);
 bool sup_page_table_has_entry (struct hash *sup_page_table, void *addr);
 
 bool sup_page_install_zero_page (void *upage);
-bool sup_page_reserve_segment (void *upage, struct file * file, off_t offset, uint32_t page_read_bytes, uint32_t page_zero_bytes, bool writable);
+bool sup_page_reserve_range (void *start, size_t size, struct file *file, off_t offset, uint32_t read_bytes, bool writable);
+void sup_page_release_range (void *start);
+void sup_page_destroy_ranges (void);
 
 bool sup_page_load_page_and_pin (void *upage, bool pinned, bool create_new);
 bool sup_page_load_page (void *upage);
+bool sup_page_map_zero (void *upage);
+bool sup_page_set_fault_around (int pages);
 
 bool sup_page_update_frame_pinned (void *upage, bool pinned);
+bool sup_page_pin_range (const void *buffer, size_t len);
+void sup_page_unpin_range (const void *buffer, size_t len);
+
+void sup_page_write_back (void *upage);
+void sup_page_unmap (void *upage);
 
-void sup_page_unmap(void* upage, int size, off_t file_ofs);
+bool sup_page_fork (struct thread *parent);
+bool sup_page_write_fault (void *upage);
 
 #endif /* vm/page.h */
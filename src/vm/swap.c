@@ -1,6 +1,13 @@
 #include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <lz.h>
+#include <round.h>
+#include <string.h>
 #include "vm/swap.h"
 #include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -11,85 +18,369 @@ static struct block *swap_block;
 /* Tracks in-use and free swap slots */
 static struct bitmap *swap_table;
 
-/* Protects swap_table */
+/* Owner of each in-use swap slot, for read-ahead */
+static int *slot_owner;
+
+/* Number of pages stored in each in-use swap slot: more than one
+   for a page shared copy-on-write when it was swapped out */
+static unsigned *slot_refs;
+
+/* Where the next search for free slots starts */
+static size_t swap_cursor;
+
+/* Protects swap_table, slot_owner, slot_refs, swap_cursor, the
+   swap cache and the compressed pool */
 static struct lock swap_lock;
 
 static const size_t sectors_per_page = (PGSIZE / BLOCK_SECTOR_SIZE);
 
+/*
+ * Swap cache.
+ * When a page is swapped in, up to SWAP_READAHEAD following slots
+ * that belong to the same process are read as well, into these
+ * kernel pages, since pages evicted together are stored together
+ * and tend to be needed together.  A later swap_in() of a cached
+ * slot copies the page instead of reading the disk.  Entries are
+ * replaced round-robin.
+ */
+#define SWAP_CACHE_SIZE 16
+#define SWAP_READAHEAD 4
+#define NO_SLOT ((size_t) -1)
+
+struct swap_cache_entry
+{
+  size_t slot;                  /* Cached slot, or NO_SLOT. */
+  void *page;                   /* Contents of SLOT. */
+};
+
+static struct swap_cache_entry swap_cache[SWAP_CACHE_SIZE];
+static size_t swap_cache_next;
+
+/*
+ * Compressed pool.
+ * A page being swapped out is first compressed.  If it shrinks
+ * to ZPOOL_MAX_SIZE bytes or less, it is kept in the pool, a
+ * slice of ZPOOL_PAGES kernel pages allocated in ZPOOL_CHUNK
+ * byte chunks, under the swap slot it was given, and the slot is
+ * not written.  Pages that do not compress that well go to the
+ * device.  When the pool is full, the pages that entered it
+ * first are written to their slots to make room.
+ */
+#define ZPOOL_PAGES 32
+#define ZPOOL_CHUNK 64
+#define ZPOOL_MAX_SIZE (PGSIZE * 3 / 4)
+
+struct zpool_entry
+{
+  uint16_t chunk;               /* First chunk of the data. */
+  uint16_t size;                /* Compressed size, 0 if not in pool. */
+  struct list_elem elem;        /* In zpool_fifo. */
+};
+
+static uint8_t *zpool;                  /* Null if not available. */
+static struct bitmap *zpool_map;        /* Chunks in use. */
+static struct zpool_entry *zpool_slot;  /* One per swap slot. */
+static struct list zpool_fifo;          /* Entries, oldest first. */
+static void *zpool_work;                /* lz_compress() scratch. */
+static uint8_t *zpool_buf;              /* Compressed page. */
+static void *zpool_page;                /* Page being written to disk. */
+
+static void
+read_slot (size_t swap_index, void *page)
+{
+  size_t i;
+  for (i = 0; i < sectors_per_page; ++i) {
+    block_read (swap_block, swap_index * sectors_per_page + i, page + (BLOCK_SECTOR_SIZE * i));
+  }
+}
+
+static void
+write_slot (size_t swap_index, const void *page)
+{
+  size_t i;
+  for (i = 0; i < sectors_per_page; ++i) {
+    block_write (swap_block, swap_index * sectors_per_page + i, page + (BLOCK_SECTOR_SIZE * i));
+  }
+}
+
+static struct swap_cache_entry *
+swap_cache_find (size_t swap_index)
+{
+  size_t i;
+  for (i = 0; i < SWAP_CACHE_SIZE; ++i) {
+    if (swap_cache[i].slot == swap_index)
+      return &swap_cache[i];
+  }
+  return NULL;
+}
+
+static void
+zpool_free (struct zpool_entry *z)
+{
+  bitmap_set_multiple (zpool_map, z->chunk,
+                       DIV_ROUND_UP (z->size, ZPOOL_CHUNK), false);
+  list_remove (&z->elem);
+  z->size = 0;
+}
+
+/* Writes the oldest page in the pool to its slot. */
+static void
+zpool_write_oldest (void)
+{
+  struct zpool_entry *z = list_entry (list_front (&zpool_fifo),
+                                      struct zpool_entry, elem);
+
+  lz_decompress (zpool + z->chunk * ZPOOL_CHUNK, z->size,
+                 zpool_page, PGSIZE);
+  write_slot (z - zpool_slot, zpool_page);
+  zpool_free (z);
+}
+
+/* Keeps PAGE compressed in the pool under SWAP_INDEX, if it
+   compresses well enough.  Returns false if it must be written
+   to the device instead. */
+static bool
+zpool_store (size_t swap_index, const void *page)
+{
+  struct zpool_entry *z = &zpool_slot[swap_index];
+  size_t size, chunk;
+
+  if (zpool == NULL)
+    return false;
+  size = lz_compress (page, PGSIZE, zpool_buf, ZPOOL_MAX_SIZE, zpool_work);
+  if (size == 0)
+    return false;
+
+  while ((chunk = bitmap_scan_and_flip (zpool_map, 0,
+                                        DIV_ROUND_UP (size, ZPOOL_CHUNK),
+                                        false)) == BITMAP_ERROR) {
+    if (list_empty (&zpool_fifo))
+      return false;
+    zpool_write_oldest ();
+  }
+
+  memcpy (zpool + chunk * ZPOOL_CHUNK, zpool_buf, size);
+  z->chunk = chunk;
+  z->size = size;
+  list_push_back (&zpool_fifo, &z->elem);
+  return true;
+}
+
+/* Reads SWAP_INDEX into PAGE if it is in the pool.  Returns false
+   if it is on the device. */
+static bool
+zpool_load (size_t swap_index, void *page)
+{
+  struct zpool_entry *z = &zpool_slot[swap_index];
+
+  if (z->size == 0)
+    return false;
+  if (lz_decompress (zpool + z->chunk * ZPOOL_CHUNK, z->size,
+                     page, PGSIZE) != PGSIZE)
+    PANIC ("Corrupt compressed swap page");
+  return true;
+}
+
+/* Drops one reference to SWAP_INDEX.  Once there are none left,
+   marks it free and drops it from the swap cache and the
+   compressed pool. */
+static void
+release_slot (size_t swap_index)
+{
+  struct swap_cache_entry *e;
+
+  ASSERT (slot_refs[swap_index] > 0);
+  if (--slot_refs[swap_index] > 0)
+    return;
+  e = swap_cache_find (swap_index);
+  if (e != NULL)
+    e->slot = NO_SLOT;
+  if (zpool_slot[swap_index].size != 0)
+    zpool_free (&zpool_slot[swap_index]);
+  bitmap_set (swap_table, swap_index, false);
+}
+
+/* Reads slots following SWAP_INDEX that OWNER also uses into the
+   swap cache, stopping at the first one that does not qualify.
+   Slots in the compressed pool need no reading. */
+static void
+read_ahead (size_t swap_index, int owner)
+{
+  size_t slot, n;
+
+  for (n = 1; n <= SWAP_READAHEAD; ++n) {
+    struct swap_cache_entry *e;
+
+    slot = swap_index + n;
+    if (slot >= bitmap_size (swap_table) || !bitmap_test (swap_table, slot)
+        || slot_owner[slot] != owner)
+      break;
+    if (swap_cache_find (slot) != NULL || zpool_slot[slot].size != 0)
+      continue;
+
+    e = &swap_cache[swap_cache_next];
+    swap_cache_next = (swap_cache_next + 1) % SWAP_CACHE_SIZE;
+    read_slot (slot, e->page);
+    e->slot = slot;
+  }
+}
+
 /* 
- * Initialize swap_block, swap_table, and swap_lock.
+ * Initialize swap_block, swap_table, swap_lock and the compressed
+ * pool.  Swapping works without the pool if there is no memory
+ * for it.
  */
 void 
 swap_init (void)
 {
+  size_t i;
+
   swap_block = block_get_role (BLOCK_SWAP);
   lock_init (&swap_lock);
   swap_table = bitmap_create (block_size (swap_block) / sectors_per_page);
+  slot_owner = calloc (bitmap_size (swap_table), sizeof *slot_owner);
+  slot_refs = calloc (bitmap_size (swap_table), sizeof *slot_refs);
+  zpool_slot = calloc (bitmap_size (swap_table), sizeof *zpool_slot);
+  if (swap_table == NULL || slot_owner == NULL || slot_refs == NULL
+      || zpool_slot == NULL)
+    PANIC ("Can not allocate swap table");
+  for (i = 0; i < SWAP_CACHE_SIZE; ++i) {
+    swap_cache[i].slot = NO_SLOT;
+    swap_cache[i].page = palloc_get_page (PAL_ASSERT);
+  }
+
+  list_init (&zpool_fifo);
+  zpool = palloc_get_multiple (0, ZPOOL_PAGES);
+  zpool_map = bitmap_create (ZPOOL_PAGES * PGSIZE / ZPOOL_CHUNK);
+  zpool_work = malloc (LZ_WORK_SIZE);
+  zpool_buf = malloc (ZPOOL_MAX_SIZE);
+  zpool_page = palloc_get_page (0);
+  if (zpool == NULL || zpool_map == NULL || zpool_work == NULL
+      || zpool_buf == NULL || zpool_page == NULL) {
+    if (zpool != NULL)
+      palloc_free_multiple (zpool, ZPOOL_PAGES);
+    zpool = NULL;
+  }
 }
 
 /*
  * Reclaim a frame from swap device.
- * 1. Check that the page has been already evicted. 
- * 2. You will want to evict an already existing frame
- * to make space to read from the disk to cache. 
- * 3. Re-link the new frame with the corresponding supplementary
- * page table entry. 
- * 4. Do NOT create a new supplementray page table entry. Use the 
- * already existing one. 
- * 5. Use helper function read_from_disk in order to read the contents
- * of the disk into the frame. 
+ * Read the page at swap_index into page, from the swap cache or
+ * the compressed pool if it is there, and drop the reference to
+ * the slot, freeing it if it was the last.  Read ahead the slots
+ * that follow.
  */ 
 void
 swap_in (size_t swap_index, void *page)
 {
+  struct swap_cache_entry *e;
+
   lock_acquire(&swap_lock);
   ASSERT (bitmap_test(swap_table, swap_index));
 
-  size_t i;
-  for (i = 0; i < sectors_per_page; ++i) {
-    block_read (swap_block, swap_index * sectors_per_page + i, page + (BLOCK_SECTOR_SIZE * i));
+  e = swap_cache_find (swap_index);
+  if (e != NULL) {
+    memcpy (page, e->page, PGSIZE);
+  } else if (!zpool_load (swap_index, page)) {
+    read_slot (swap_index, page);
+    read_ahead (swap_index, slot_owner[swap_index]);
   }
 
-  bitmap_set(swap_table, swap_index, false);
+  release_slot (swap_index);
+  lock_release(&swap_lock);
+}
+
+/*
+ * Read the page at swap_index into page, like swap_in(), but
+ * keep the slot.  Used by fork() to copy a swapped-out page.
+ */
+void
+swap_copy (size_t swap_index, void *page)
+{
+  struct swap_cache_entry *e;
+
+  lock_acquire(&swap_lock);
+  ASSERT (bitmap_test(swap_table, swap_index));
+
+  e = swap_cache_find (swap_index);
+  if (e != NULL)
+    memcpy (page, e->page, PGSIZE);
+  else if (!zpool_load (swap_index, page))
+    read_slot (swap_index, page);
+  lock_release(&swap_lock);
+}
+
+/*
+ * Evict cnt pages to the swap device, storing the slot of
+ * pages[i] in swap_index[i].  The pages go to consecutive slots
+ * when a long enough run is free, so that pages evicted together
+ * can be read back together.  owner is the thread whose pages
+ * they are (its tid), used to limit read-ahead to one process.
+ * Pages that compress well are kept in the compressed pool
+ * instead of being written.
+ */
+void
+swap_out_cluster (void *pages[], size_t cnt, int owner, size_t swap_index[])
+{
+  size_t first, i;
+
+  lock_acquire(&swap_lock);
+  first = bitmap_scan (swap_table, swap_cursor, cnt, false);
+  if (first == BITMAP_ERROR)
+    first = bitmap_scan (swap_table, 0, cnt, false);
+
+  for (i = 0; i < cnt; ++i) {
+    size_t slot = first;
+    if (slot == BITMAP_ERROR) {
+      slot = bitmap_scan (swap_table, 0, 1, false);
+      if (slot == BITMAP_ERROR)
+        PANIC ("Swap device full");
+    } else {
+      slot += i;
+    }
+
+    bitmap_set (swap_table, slot, true);
+    slot_refs[slot] = 1;
+    if (!zpool_store (slot, pages[i]))
+      write_slot (slot, pages[i]);
+    slot_owner[slot] = owner;
+    swap_index[i] = slot;
+    swap_cursor = slot + 1;
+  }
   lock_release(&swap_lock);
 }
 
 /* 
  * Evict a frame to swap device. 
- * 1. Choose the frame you want to evict. 
- * (Ex. Least Recently Used policy -> Compare the timestamps when each 
- * frame is last accessed)
- * 2. Evict the frame. Unlink the frame from the supplementray page table entry
- * Remove the frame from the frame table after freeing the frame with
- * pagedir_clear_page. 
- * 3. Do NOT delete the supplementary page table entry. The process
- * should have the illusion that they still have the page allocated to
- * them. 
- * 4. Find a free block to write you data. Use swap table to get track
- * of in-use and free swap slots.
+ * owner is the tid of the thread whose page it is.
  */
 size_t
-swap_out (void *addr)
+swap_out (void *addr, int owner)
 {
-  lock_acquire(&swap_lock);
-  // TODO: Validation?
   size_t swap_index;
-  size_t i;
-  swap_index = bitmap_scan (swap_table, 0, 1, false);
-  for (i = 0; i < sectors_per_page; ++i) {
-    block_write (swap_block, swap_index * sectors_per_page + i, addr + (BLOCK_SECTOR_SIZE * i));
-  }
-  bitmap_set (swap_table, swap_index, true);
-  lock_release(&swap_lock);
+  swap_out_cluster (&addr, 1, owner, &swap_index);
   return swap_index;
 }
 
 
+/*
+ * Add cnt more references to swap_index, for the other processes
+ * that shared the page swapped out to it.  Each reference is
+ * dropped by swap_in() or free_swap_slot().
+ */
 void
-free_swap_slot (size_t swap_index)
+swap_dup (size_t swap_index, unsigned cnt)
 {
   lock_acquire(&swap_lock);
-  bitmap_set (swap_table, swap_index, true);
+  ASSERT (bitmap_test(swap_table, swap_index));
+  slot_refs[swap_index] += cnt;
   lock_release(&swap_lock);
 }
 
+void
+free_swap_slot (size_t swap_index)
+{
+  lock_acquire(&swap_lock);
+  release_slot (swap_index);
+  lock_release(&swap_lock);
+}
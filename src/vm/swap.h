@@ -7,7 +7,11 @@
 
 void swap_init (void);
 void swap_in (size_t swap_index, void *page);
-size_t swap_out (void *addr);
+void swap_copy (size_t swap_index, void *page);
+/* OWNER is the tid of the thread whose pages are swapped out. */
+size_t swap_out (void *addr, int owner);
+void swap_out_cluster (void *pages[], size_t cnt, int owner, size_t swap_index[]);
+void swap_dup (size_t swap_index, unsigned cnt);
 void free_swap_slot (size_t swap_index);
 
 #endif /* vm/swap.h */